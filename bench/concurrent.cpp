@@ -0,0 +1,389 @@
+#include <iostream>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <array>
+#include <tuple>
+#include <random>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <numeric>
+#include <algorithm>
+
+#include "triemap/triemap.h"
+
+//-------------------------------------------------------------------------------------------------
+// Mixed workload benchmark. Reader threads call match while writer threads insert and erase users
+// or roll up utilization along a path, as in the aggregation example. The trie-map is guarded by a
+// reader-writer lock, so the reported latencies include the time spent waiting for it.
+//-------------------------------------------------------------------------------------------------
+
+struct Limit
+{
+    uint64_t threshold   = 0;
+    uint64_t utilization = 0;
+};
+
+using Limits = O3::collection::utriemap<Limit, uint32_t, uint32_t, uint32_t>;
+using Key    = std::tuple<uint32_t, uint32_t, uint32_t>;
+
+//-------------------------------------------------------------------------------------------------
+// Log-linear latency histogram. Values are grouped by power of two with 16 linear sub-buckets, which
+// keeps the relative error of reported percentiles under 7%.
+//-------------------------------------------------------------------------------------------------
+class Histogram
+{
+    static constexpr unsigned SUB = 16;
+
+    std::array<uint64_t, 64 * SUB> m_counts{};
+    uint64_t                       m_total = 0;
+    uint64_t                       m_max   = 0;
+
+    static size_t index(uint64_t v)
+    {
+        if (v < SUB) {
+            return v;
+        }
+        unsigned msb = 0;
+        while (v >> (msb + 1)) {
+            ++msb;
+        }
+        unsigned sub = (v >> (msb - 4)) & (SUB - 1);
+        return (msb - 3) * SUB + sub;
+    }
+
+    static uint64_t value(size_t i)
+    {
+        if (i < SUB) {
+            return i;
+        }
+        unsigned msb = i / SUB + 3;
+        return (uint64_t(SUB + i % SUB) << (msb - 4)) + (uint64_t(1) << (msb - 4)) - 1;
+    }
+
+public:
+    void record(uint64_t v)
+    {
+        ++m_counts[index(v)];
+        ++m_total;
+        m_max = std::max(m_max, v);
+    }
+
+    void merge(const Histogram& oth)
+    {
+        for (size_t i = 0; i < m_counts.size(); ++i) {
+            m_counts[i] += oth.m_counts[i];
+        }
+        m_total += oth.m_total;
+        m_max = std::max(m_max, oth.m_max);
+    }
+
+    [[nodiscard]] uint64_t total() const
+    {
+        return m_total;
+    }
+
+    [[nodiscard]] uint64_t max() const
+    {
+        return m_max;
+    }
+
+    // Upper bound of the bucket holding the given percentile
+    [[nodiscard]] uint64_t percentile(double p) const
+    {
+        auto     rank = static_cast<uint64_t>(std::ceil(p / 100.0 * m_total));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < m_counts.size(); ++i) {
+            seen += m_counts[i];
+            if (seen >= rank && seen > 0) {
+                return std::min(value(i), m_max);
+            }
+        }
+        return m_max;
+    }
+};
+
+//-------------------------------------------------------------------------------------------------
+// Key distributions. Zipfian generator follows Gray et al., "Quickly generating billion-record
+// synthetic databases", with rank zero being the most popular. Theta must be less than one.
+//-------------------------------------------------------------------------------------------------
+class Zipf
+{
+    uint64_t m_n;
+    double   m_theta, m_alpha, m_zetan, m_eta;
+
+    static double zeta(uint64_t n, double theta)
+    {
+        double sum = 0;
+        for (uint64_t i = 1; i <= n; ++i) {
+            sum += 1.0 / std::pow(static_cast<double>(i), theta);
+        }
+        return sum;
+    }
+
+public:
+    Zipf(uint64_t n, double theta)
+      : m_n(n)
+      , m_theta(theta)
+      , m_alpha(1.0 / (1.0 - theta))
+      , m_zetan(zeta(n, theta))
+      , m_eta((1.0 - std::pow(2.0 / n, 1.0 - theta)) / (1.0 - zeta(2, theta) / m_zetan))
+    {}
+
+    template<typename RNG>
+    uint64_t operator()(RNG& rng) const
+    {
+        double u  = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+        double uz = u * m_zetan;
+        if (uz < 1.0) {
+            return 0;
+        }
+        if (uz < 1.0 + std::pow(0.5, m_theta)) {
+            return 1;
+        }
+        return std::min<uint64_t>(m_n - 1, static_cast<uint64_t>(m_n * std::pow(m_eta * u - m_eta + 1.0, m_alpha)));
+    }
+};
+
+//-------------------------------------------------------------------------------------------------
+// Configuration
+//-------------------------------------------------------------------------------------------------
+struct Options
+{
+    unsigned    readers  = 4;
+    unsigned    writers  = 1;
+    double      seconds  = 2.0;
+    uint32_t    fanout0  = 16;
+    uint32_t    fanout1  = 16;
+    uint32_t    fanout2  = 256;
+    std::string dist     = "uniform";
+    double      theta    = 0.99;
+    std::string write_op = "insert-erase";
+    std::string lock     = "shared";
+    uint64_t    seed     = 42;
+};
+
+// Keeps lookups from being optimized away
+const void* volatile sink;
+
+struct Result
+{
+    Histogram latency;
+    uint64_t  ops = 0;
+};
+
+class Workload
+{
+    const Options&        m_opts;
+    Limits                m_limits;
+    std::shared_mutex     m_mutex;
+    std::atomic<bool>     m_stop{ false };
+    Zipf                  m_zipf;
+    std::vector<uint64_t> m_order; // Key of every rank
+
+    [[nodiscard]] uint64_t keys() const
+    {
+        return uint64_t(m_opts.fanout0) * m_opts.fanout1 * m_opts.fanout2;
+    }
+
+    [[nodiscard]] Key key(uint64_t rank) const
+    {
+        uint64_t k = m_order[rank];
+        return Key(k % m_opts.fanout0, (k / m_opts.fanout0) % m_opts.fanout1, k / m_opts.fanout0 / m_opts.fanout1);
+    }
+
+    template<typename RNG>
+    Key next(RNG& rng) const
+    {
+        uint64_t rank = m_opts.dist == "zipf" ? m_zipf(rng) : std::uniform_int_distribution<uint64_t>(0, keys() - 1)(rng);
+        return key(rank);
+    }
+
+    template<typename F>
+    void read_locked(F&& f)
+    {
+        if (m_opts.lock == "shared") {
+            std::shared_lock<std::shared_mutex> lock(m_mutex);
+            f();
+        } else {
+            std::unique_lock<std::shared_mutex> lock(m_mutex);
+            f();
+        }
+    }
+
+    template<typename F>
+    void write_locked(F&& f)
+    {
+        std::unique_lock<std::shared_mutex> lock(m_mutex);
+        f();
+    }
+
+    template<typename OP>
+    Result loop(uint64_t seed, OP&& op)
+    {
+        std::mt19937_64 rng(seed);
+        Result          result;
+        while (!m_stop.load(std::memory_order_relaxed)) {
+            auto k     = next(rng);
+            auto start = std::chrono::steady_clock::now();
+            op(k, rng);
+            auto stop = std::chrono::steady_clock::now();
+            result.latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count());
+            ++result.ops;
+        }
+        return result;
+    }
+
+public:
+    explicit Workload(const Options& opts)
+      : m_opts(opts)
+      , m_zipf(uint64_t(opts.fanout0) * opts.fanout1 * opts.fanout2, opts.theta)
+      , m_order(keys())
+    {
+        // Scatter popular ranks across the tree so that hot keys do not share a parent
+        std::iota(m_order.begin(), m_order.end(), uint64_t(0));
+        std::shuffle(m_order.begin(), m_order.end(), std::mt19937_64(opts.seed));
+
+        // Limits at every level, users at every other slot so that writers have room to insert
+        for (uint64_t r = 0; r < keys(); ++r) {
+            auto [a, b, c] = key(r);
+            m_limits.insert(Limit{ 100000000 }, a);
+            m_limits.insert(Limit{ 1000000 }, a, b);
+            if (c % 2 == 0) {
+                m_limits.insert(Limit{ 1000 }, a, b, c);
+            }
+        }
+        m_limits.insert(Limit{ 10000000000 });
+    }
+
+    Result reader(uint64_t seed)
+    {
+        return loop(seed, [&](const Key& k, auto&) {
+            read_locked([&] {
+                sink = m_limits.match(std::get<0>(k), std::get<1>(k), std::get<2>(k));
+            });
+        });
+    }
+
+    Result writer(uint64_t seed)
+    {
+        if (m_opts.write_op == "rollup") {
+            return loop(seed, [&](const Key& k, auto& rng) {
+                uint64_t delta = rng() % 2 ? 1 : -1;
+                write_locked([&] {
+                    m_limits.climb_pre(
+                        [&](auto& n, auto&&...) {
+                            if (n) {
+                                n->utilization += delta;
+                            }
+                            return true;
+                        },
+                        std::get<0>(k),
+                        std::get<1>(k),
+                        std::get<2>(k));
+                });
+            });
+        }
+        return loop(seed, [&](const Key& k, auto& rng) {
+            bool insert = rng() % 2;
+            write_locked([&] {
+                if (insert) {
+                    m_limits.insert(Limit{ 1000 }, std::get<0>(k), std::get<1>(k), std::get<2>(k));
+                } else {
+                    m_limits.erase(std::get<0>(k), std::get<1>(k), std::get<2>(k));
+                }
+            });
+        });
+    }
+
+    void stop()
+    {
+        m_stop = true;
+    }
+};
+
+void
+report(const char* role, unsigned threads, const Result& r, double seconds, const Options& opts)
+{
+    std::cout << "{\"role\":\"" << role << "\",\"threads\":" << threads << ",\"dist\":\"" << opts.dist
+              << "\",\"write_op\":\"" << opts.write_op << "\",\"lock\":\"" << opts.lock << "\",\"ops\":" << r.ops
+              << ",\"ops_per_sec\":" << static_cast<uint64_t>(r.ops / seconds)
+              << ",\"p50_ns\":" << r.latency.percentile(50) << ",\"p99_ns\":" << r.latency.percentile(99)
+              << ",\"p999_ns\":" << r.latency.percentile(99.9) << ",\"max_ns\":" << r.latency.max() << '}'
+              << std::endl;
+}
+
+int
+main(int argc, char* argv[])
+{
+    Options opts;
+    for (int i = 1; i < argc; ++i) {
+        auto arg = [&](const char* name) { return std::strcmp(argv[i], name) == 0 && i + 1 < argc; };
+        if (arg("--readers")) {
+            opts.readers = std::stoul(argv[++i]);
+        } else if (arg("--writers")) {
+            opts.writers = std::stoul(argv[++i]);
+        } else if (arg("--seconds")) {
+            opts.seconds = std::stod(argv[++i]);
+        } else if (arg("--shape")) {
+            if (std::sscanf(argv[++i], "%ux%ux%u", &opts.fanout0, &opts.fanout1, &opts.fanout2) != 3) {
+                std::cerr << "Shape must be given as AxBxC\n";
+                return 1;
+            }
+        } else if (arg("--dist")) {
+            opts.dist = argv[++i];
+        } else if (arg("--theta")) {
+            opts.theta = std::stod(argv[++i]);
+            if (opts.theta == 1.0) {
+                std::cerr << "Theta must not be 1\n";
+                return 1;
+            }
+        } else if (arg("--write")) {
+            opts.write_op = argv[++i];
+        } else if (arg("--lock")) {
+            opts.lock = argv[++i];
+        } else if (arg("--seed")) {
+            opts.seed = std::stoull(argv[++i]);
+        } else {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--readers N] [--writers N] [--seconds S] [--shape AxBxC] [--dist uniform|zipf]"
+                         " [--theta T] [--write insert-erase|rollup] [--lock shared|exclusive] [--seed N]\n";
+            return 1;
+        }
+    }
+
+    Workload            workload(opts);
+    std::vector<Result> readers(opts.readers), writers(opts.writers);
+    std::vector<std::thread> threads;
+
+    for (unsigned i = 0; i < opts.readers; ++i) {
+        threads.emplace_back([&, i] { readers[i] = workload.reader(opts.seed + i); });
+    }
+    for (unsigned i = 0; i < opts.writers; ++i) {
+        threads.emplace_back([&, i] { writers[i] = workload.writer(opts.seed + opts.readers + i); });
+    }
+
+    std::this_thread::sleep_for(std::chrono::duration<double>(opts.seconds));
+    workload.stop();
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    auto combine = [](const std::vector<Result>& rs) {
+        Result total;
+        for (const auto& r : rs) {
+            total.latency.merge(r.latency);
+            total.ops += r.ops;
+        }
+        return total;
+    };
+
+    report("reader", opts.readers, combine(readers), opts.seconds, opts);
+    report("writer", opts.writers, combine(writers), opts.seconds, opts);
+    return 0;
+}
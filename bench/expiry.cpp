@@ -0,0 +1,160 @@
+#include <iostream>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <tuple>
+#include <random>
+#include <chrono>
+#include <algorithm>
+
+#include "triemap/triemap.h"
+#include "triemap/expiring.h"
+
+//-------------------------------------------------------------------------------------------------
+// Expiry of temporary feature-flag overrides. A trie-map keyed by feature, division, department
+// and user holds permanent flags for every user, and every minute a batch of overrides with a
+// random time to live is inserted. Expired overrides are erased either by sweeping the whole
+// trie-map with a traversal, whose data carries the deadline, or by the timer wheel of expiring.
+// Results are printed as JSON objects per line.
+//-------------------------------------------------------------------------------------------------
+
+using Key   = std::string;
+using Path  = std::tuple<Key, Key, Key, Key>;
+using Swept = O3::collection::utriemap<std::pair<bool, uint64_t>, Key, Key, Key, Key>; // Flag and deadline, 0 if none
+using Wheel = O3::collection::expiring<O3::collection::utriemap<bool, Key, Key, Key, Key>>;
+
+struct Options
+{
+    size_t   users   = 1000000; // Users with a permanent flag
+    size_t   batch   = 1000;    // Overrides inserted per minute
+    size_t   ttl     = 60;      // Longest time to live in minutes
+    size_t   minutes = 240;
+    uint64_t seed    = 42;
+};
+
+// Every user of a division and department shape holds a permanent flag, overrides pick random users
+struct Workload
+{
+    std::vector<Path>                users;
+    std::vector<std::vector<Path>>   batches;
+    std::vector<std::vector<size_t>> ttls;
+
+    static Path path(const char* feature, size_t u)
+    {
+        return Path(feature, "div" + std::to_string(u % 8), "dep" + std::to_string(u % 64), std::to_string(u));
+    }
+
+    explicit Workload(const Options& opts)
+    {
+        std::mt19937_64 rng(opts.seed);
+        for (size_t u = 0; u < opts.users; ++u) {
+            users.push_back(path("flag", u));
+        }
+        batches.resize(opts.minutes);
+        ttls.resize(opts.minutes);
+        for (size_t m = 0; m < opts.minutes; ++m) {
+            for (size_t i = 0; i < opts.batch; ++i) {
+                batches[m].push_back(path("override", rng() % opts.users));
+                ttls[m].push_back(1 + rng() % opts.ttl);
+            }
+        }
+    }
+};
+
+// Sweep every minute, collecting the paths of expired data with a traversal and erasing them after it
+uint64_t
+sweep(Swept& tm, uint64_t now, std::vector<Path>& expired)
+{
+    expired.clear();
+    std::vector<const Key*> keys;
+    tm.traverse_dfs(
+        [&](const auto& n, const auto&... k) {
+            (keys.push_back(&k), ...);
+            if (n && n->second != 0 && n->second <= now) {
+                expired.emplace_back(*keys[0], *keys[1], *keys[2], *keys[3]);
+            }
+            return true;
+        },
+        [&](const auto&, const auto&... k) {
+            ((void(k), keys.pop_back()), ...);
+            return true;
+        });
+    for (const auto& p : expired) {
+        std::apply([&](const auto&... k) { tm.erase(k...); }, p);
+    }
+    return expired.size();
+}
+
+template<typename F>
+void
+report(const Options& opts, const char* container, F&& run)
+{
+    auto     start   = std::chrono::steady_clock::now();
+    uint64_t expired = run();
+    auto     ns      = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "{\"bench\":\"expiry\",\"container\":\"" << container << "\",\"users\":" << opts.users
+              << ",\"batch\":" << opts.batch << ",\"minutes\":" << opts.minutes << ",\"expired\":" << expired
+              << ",\"total_ns\":" << static_cast<uint64_t>(ns)
+              << ",\"ns_per_minute\":" << ns / static_cast<double>(opts.minutes)
+              << ",\"ns_per_expired\":" << (expired ? ns / static_cast<double>(expired) : 0.0) << '}' << std::endl;
+}
+
+int
+main(int argc, char* argv[])
+{
+    Options opts;
+    for (int i = 1; i < argc; ++i) {
+        auto arg = [&](const char* name) { return std::strcmp(argv[i], name) == 0 && i + 1 < argc; };
+        if (arg("--users")) {
+            opts.users = std::max(1ul, std::stoul(argv[++i]));
+        } else if (arg("--batch")) {
+            opts.batch = std::stoul(argv[++i]);
+        } else if (arg("--ttl")) {
+            opts.ttl = std::max(1ul, std::stoul(argv[++i]));
+        } else if (arg("--minutes")) {
+            opts.minutes = std::max(1ul, std::stoul(argv[++i]));
+        } else if (arg("--seed")) {
+            opts.seed = std::stoull(argv[++i]);
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--users N] [--batch N] [--ttl N] [--minutes N] [--seed N]\n";
+            return 1;
+        }
+    }
+
+    Workload w(opts);
+
+    // Only the minute loop is timed, the permanent flags are loaded before
+    Swept swept;
+    for (const auto& u : w.users) {
+        std::apply([&](const auto&... k) { swept.insert(std::make_pair(true, uint64_t(0)), k...); }, u);
+    }
+    report(opts, "sweep", [&] {
+        uint64_t          expired = 0;
+        std::vector<Path> paths;
+        for (size_t m = 0; m < opts.minutes; ++m) {
+            for (size_t i = 0; i < w.batches[m].size(); ++i) {
+                std::apply([&](const auto&... k) { swept.insert(std::make_pair(false, m + w.ttls[m][i]), k...); },
+                           w.batches[m][i]);
+            }
+            expired += sweep(swept, m + 1, paths);
+        }
+        return expired;
+    });
+
+    Wheel wheel;
+    for (const auto& u : w.users) {
+        std::apply([&](const auto&... k) { wheel.insert(true, k...); }, u);
+    }
+    report(opts, "wheel", [&] {
+        uint64_t expired = 0;
+        for (size_t m = 0; m < opts.minutes; ++m) {
+            for (size_t i = 0; i < w.batches[m].size(); ++i) {
+                std::apply([&](const auto&... k) { wheel.insert_for(w.ttls[m][i], false, k...); }, w.batches[m][i]);
+            }
+            expired += wheel.advance(m + 1);
+        }
+        return expired;
+    });
+    return 0;
+}
@@ -0,0 +1,129 @@
+#include <iostream>
+#include <fstream>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <random>
+#include <chrono>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "triemap/triemap.h"
+#include "triemap/io/json.h"
+#include "triemap/io/exporter.h"
+
+//-------------------------------------------------------------------------------------------------
+// Export throughput. A three level trie-map is exported to a file in every JSON format and in
+// the line format through the chunked exporter, and through an output file stream for
+// comparison. Results are printed as JSON objects per line.
+//-------------------------------------------------------------------------------------------------
+
+using Data = uint64_t;
+using Trie = O3::collection::otriemap<Data, uint32_t, uint32_t, uint32_t>;
+
+struct Options
+{
+    size_t      size   = 1000000;
+    size_t      fanout = 100;
+    size_t      chunk  = 1 << 16;
+    size_t      chunks = 16;
+    uint64_t    seed   = 42;
+    std::string file   = "/dev/null";
+};
+
+void
+report(const char* bench, const char* format, bool pretty, const Options& opts, const O3::io::export_stats& st)
+{
+    std::cout << "{\"bench\":\"" << bench << "\",\"format\":\"" << format << "\",\"pretty\":" << (pretty ? "true" : "false")
+              << ",\"chunk\":" << opts.chunk << ",\"chunks\":" << opts.chunks << ",\"bytes\":" << st.bytes
+              << ",\"writes\":" << st.writes << ",\"seconds\":" << st.seconds
+              << ",\"mb_per_s\":" << st.bytes_per_second() / (1 << 20) << "}" << std::endl;
+}
+
+// Run the export into a freshly truncated file
+template<typename F>
+O3::io::export_stats
+to_fd(const Options& opts, F&& f)
+{
+    int fd = ::open(opts.file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open " + opts.file);
+    }
+    O3::io::exporter e(fd, opts.chunk, opts.chunks);
+    auto             st = f(e);
+    ::close(fd);
+    return st;
+}
+
+template<typename F>
+O3::io::export_stats
+to_stream(const Options& opts, F&& f)
+{
+    std::ofstream os(opts.file, std::ios::binary | std::ios::trunc);
+    auto          start = std::chrono::steady_clock::now();
+    f(os);
+    os.flush();
+    O3::io::export_stats st;
+    st.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    st.bytes   = static_cast<size_t>(os.tellp());
+    return st;
+}
+
+int
+main(int argc, char* argv[])
+{
+    Options opts;
+    for (int i = 1; i < argc; ++i) {
+        auto arg = [&](const char* name) { return std::strcmp(argv[i], name) == 0 && i + 1 < argc; };
+        if (arg("--size")) {
+            opts.size = std::max(1ul, std::stoul(argv[++i]));
+        } else if (arg("--fanout")) {
+            opts.fanout = std::max(1ul, std::stoul(argv[++i]));
+        } else if (arg("--chunk")) {
+            opts.chunk = std::max(1ul, std::stoul(argv[++i]));
+        } else if (arg("--chunks")) {
+            opts.chunks = std::max(1ul, std::stoul(argv[++i]));
+        } else if (arg("--seed")) {
+            opts.seed = std::stoull(argv[++i]);
+        } else if (arg("--file")) {
+            opts.file = argv[++i];
+        } else {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--size N] [--fanout N] [--chunk N] [--chunks N] [--seed N] [--file PATH]\n";
+            return 1;
+        }
+    }
+
+    std::mt19937_64 rng(opts.seed);
+    Trie            tm;
+    for (size_t i = 0; i < opts.size; ++i) {
+        auto f = static_cast<uint32_t>(opts.fanout);
+        tm.insert(rng() % 1000000, static_cast<uint32_t>(i / (f * f)), static_cast<uint32_t>(i / f % f), i % f);
+    }
+
+    using O3::io::json::kind;
+    const std::pair<kind, const char*> kinds[] = {
+        { kind::like, "like" },
+        { kind::proper, "proper" },
+        { kind::d3, "d3" },
+    };
+
+    for (auto [k, name] : kinds) {
+        for (bool pretty : { true, false }) {
+            report("exporter", name, pretty, opts, to_fd(opts, [&, k = k](O3::io::exporter& e) {
+                       return e.json(tm, k, pretty);
+                   }));
+        }
+        report("ofstream", name, true, opts, to_stream(opts, [&, k = k](std::ostream& os) {
+                   switch (k) {
+                       case kind::like: os << O3::io::json::like(tm); break;
+                       case kind::proper: os << O3::io::json::proper(tm); break;
+                       case kind::d3: os << O3::io::json::d3(tm); break;
+                   }
+               }));
+    }
+    report("exporter", "lines", false, opts, to_fd(opts, [&](O3::io::exporter& e) { return e.lines(tm); }));
+    return 0;
+}
@@ -0,0 +1,120 @@
+#include <iostream>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <tuple>
+#include <random>
+#include <chrono>
+#include <algorithm>
+
+#include "triemap/triemap.h"
+
+//-------------------------------------------------------------------------------------------------
+// Bulk load of users under a few divisions and departments. An unordered trie-map is loaded
+// without hints, with the expected fan-out of every level given by fanout_policy, and with
+// reserve of the exact size of every department before its users are inserted. Results are
+// printed as JSON objects per line.
+//-------------------------------------------------------------------------------------------------
+
+using Data = uint64_t;
+using Key  = uint32_t;
+using Path = std::tuple<Key, Key, Key>;
+
+struct Options
+{
+    size_t   users       = 1000000;
+    size_t   divisions   = 8;
+    size_t   departments = 16; // Per division
+    size_t   reps        = 5;
+    uint64_t seed        = 42;
+};
+
+// Hints for the default shape, departments hold about 1000000 / 128 users
+using Plain  = O3::collection::utriemap<Data, Key, Key, Key>;
+using Hinted = O3::collection::basic_utriemap<O3::collection::fanout_policy<8, 16, 8192>, Data, Key, Key, Key>;
+
+// Users arrive in random order, the size of every department is known up front
+struct Workload
+{
+    std::vector<Path>                users;
+    std::vector<std::vector<size_t>> sizes;
+
+    explicit Workload(const Options& opts)
+      : sizes(opts.divisions, std::vector<size_t>(opts.departments))
+    {
+        std::mt19937_64 rng(opts.seed);
+        for (size_t u = 0; u < opts.users; ++u) {
+            auto div = static_cast<Key>(rng() % opts.divisions);
+            auto dep = static_cast<Key>(rng() % opts.departments);
+            users.emplace_back(div, dep, static_cast<Key>(u));
+            ++sizes[div][dep];
+        }
+    }
+};
+
+volatile uint64_t sink;
+
+template<typename TM, typename PREPARE>
+void
+run(const Options& opts, const Workload& w, const char* container, PREPARE&& prepare)
+{
+    double                     best = 0;
+    O3::collection::statistics st;
+    for (size_t r = 0; r < opts.reps; ++r) {
+        auto start = std::chrono::steady_clock::now();
+        {
+            TM tm;
+            prepare(tm);
+            for (const auto& [div, dep, user] : w.users) {
+                tm.insert(Data(user), div, dep, user);
+            }
+            auto ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+            best    = r == 0 ? ns : std::min(best, ns);
+            st      = tm.stats();
+            sink    = tm.size();
+        }
+    }
+    std::cout << "{\"bench\":\"load\",\"container\":\"" << container << "\",\"users\":" << opts.users
+              << ",\"divisions\":" << opts.divisions << ",\"departments\":" << opts.departments
+              << ",\"reps\":" << opts.reps << ",\"total_ns\":" << static_cast<uint64_t>(best)
+              << ",\"ns_per_op\":" << best / static_cast<double>(opts.users) << ",\"bytes\":" << st.bytes()
+              << ",\"allocations\":" << st.allocations << '}' << std::endl;
+}
+
+int
+main(int argc, char* argv[])
+{
+    Options opts;
+    for (int i = 1; i < argc; ++i) {
+        auto arg = [&](const char* name) { return std::strcmp(argv[i], name) == 0 && i + 1 < argc; };
+        if (arg("--users")) {
+            opts.users = std::max(1ul, std::stoul(argv[++i]));
+        } else if (arg("--divisions")) {
+            opts.divisions = std::max(1ul, std::stoul(argv[++i]));
+        } else if (arg("--departments")) {
+            opts.departments = std::max(1ul, std::stoul(argv[++i]));
+        } else if (arg("--reps")) {
+            opts.reps = std::max(1ul, std::stoul(argv[++i]));
+        } else if (arg("--seed")) {
+            opts.seed = std::stoull(argv[++i]);
+        } else {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--users N] [--divisions N] [--departments N] [--reps N] [--seed N]\n";
+            return 1;
+        }
+    }
+
+    Workload w(opts);
+
+    run<Plain>(opts, w, "plain", [](Plain&) {});
+    run<Hinted>(opts, w, "fanout_policy", [](Hinted&) {});
+    run<Plain>(opts, w, "reserve", [&](Plain& tm) {
+        for (Key div = 0; div < opts.divisions; ++div) {
+            for (Key dep = 0; dep < opts.departments; ++dep) {
+                tm.reserve(w.sizes[div][dep], div, dep);
+            }
+        }
+    });
+    return 0;
+}
@@ -0,0 +1,545 @@
+#include <iostream>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <tuple>
+#include <map>
+#include <unordered_map>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <cmath>
+#include <sstream>
+
+#include "triemap/triemap.h"
+#include "triemap/algo/reduce.h"
+#include "triemap/algo/fold.h"
+#include "triemap/algo/pivot.h"
+#include "triemap/io/json.h"
+#include "triemap/io/binary.h"
+
+//-------------------------------------------------------------------------------------------------
+// Microbenchmarks of triemap flavours against flat maps with a tuple key. Every measurement is
+// printed as one JSON object per line, so results can be collected and compared between runs.
+//-------------------------------------------------------------------------------------------------
+
+// Three level hierarchy, think of division, department and user
+using Key  = std::tuple<uint32_t, uint32_t, uint32_t>;
+using Data = uint64_t;
+
+// Flat map prefixes use this value for the missing trailing elements
+constexpr uint32_t ANY = UINT32_MAX;
+
+struct KeyHash
+{
+    size_t operator()(const Key& k) const
+    {
+        size_t h = std::hash<uint32_t>()(std::get<0>(k));
+        h        = h * 1000003 ^ std::hash<uint32_t>()(std::get<1>(k));
+        h        = h * 1000003 ^ std::hash<uint32_t>()(std::get<2>(k));
+        return h;
+    }
+};
+
+//-------------------------------------------------------------------------------------------------
+// Uniform interface over the benchmarked containers
+//-------------------------------------------------------------------------------------------------
+template<typename TM>
+struct Trie
+{
+    TM tm;
+
+    void insert(const Key& k, Data d)
+    {
+        std::apply([&](auto... ks) { tm.insert(d, ks...); }, k);
+    }
+    void insert_prefix(const Key& k, size_t depth, Data d)
+    {
+        auto [a, b, c] = k;
+        switch (depth) {
+            case 0: tm.insert(d); break;
+            case 1: tm.insert(d, a); break;
+            case 2: tm.insert(d, a, b); break;
+            default: tm.insert(d, a, b, c); break;
+        }
+    }
+    const Data* find(const Key& k) const
+    {
+        return std::apply([&](auto... ks) { return tm.find(ks...); }, k);
+    }
+    const Data* match(const Key& k) const
+    {
+        return std::apply([&](auto... ks) { return tm.match(ks...); }, k);
+    }
+    size_t erase(const Key& k)
+    {
+        return std::apply([&](auto... ks) { return tm.erase(ks...); }, k);
+    }
+    Data traverse() const
+    {
+        Data sum = 0;
+        tm.traverse_pre([&](const auto& n, auto&&...) {
+            if (n) {
+                sum += *n;
+            }
+            return true;
+        });
+        return sum;
+    }
+    bool reduce()
+    {
+        O3::algo::reduce(tm);
+        return true;
+    }
+    size_t stream() const
+    {
+        std::ostringstream os;
+        os << O3::io::json::proper(tm);
+        return os.str().size();
+    }
+    size_t write() const
+    {
+        O3::io::json::writer w;
+        return w.write(tm, O3::io::json::kind::proper).size();
+    }
+    std::string save() const
+    {
+        return O3::io::binary::save(tm);
+    }
+    size_t load(const std::string& bytes)
+    {
+        O3::io::binary::load(bytes, tm);
+        return tm.size();
+    }
+};
+
+template<typename FM>
+struct Flat
+{
+    FM fm;
+
+    void insert(const Key& k, Data d)
+    {
+        fm.emplace(k, d);
+    }
+    void insert_prefix(const Key& k, size_t depth, Data d)
+    {
+        fm.emplace(prefix(k, depth), d);
+    }
+    const Data* find(const Key& k) const
+    {
+        auto itr = fm.find(k);
+        return itr != fm.end() ? &itr->second : nullptr;
+    }
+    // Try the full key, then shorter and shorter prefixes
+    const Data* match(const Key& k) const
+    {
+        for (size_t depth = 4; depth-- > 0;) {
+            auto itr = fm.find(prefix(k, depth));
+            if (itr != fm.end()) {
+                return &itr->second;
+            }
+        }
+        return nullptr;
+    }
+    size_t erase(const Key& k)
+    {
+        return fm.erase(k);
+    }
+    Data traverse() const
+    {
+        Data sum = 0;
+        for (const auto& e : fm) {
+            sum += e.second;
+        }
+        return sum;
+    }
+    bool reduce()
+    {
+        return false;
+    }
+    size_t stream() const
+    {
+        return 0;
+    }
+    size_t write() const
+    {
+        return 0;
+    }
+    std::string save() const
+    {
+        return {};
+    }
+    size_t load(const std::string&)
+    {
+        return 0;
+    }
+
+    static Key prefix(const Key& k, size_t depth)
+    {
+        auto [a, b, c] = k;
+        return Key(depth > 0 ? a : ANY, depth > 1 ? b : ANY, depth > 2 ? c : ANY);
+    }
+};
+
+//-------------------------------------------------------------------------------------------------
+// Key set generation. Shape gives the fan-out of the two upper levels, leaves take the rest.
+//-------------------------------------------------------------------------------------------------
+struct Shape
+{
+    const char* name;
+    std::function<std::pair<size_t, size_t>(size_t)> fanout;
+};
+
+const Shape shapes[] = {
+    { "balanced",
+      [](size_t n) {
+          auto f = static_cast<size_t>(std::ceil(std::cbrt(static_cast<double>(n))));
+          return std::make_pair(f, f);
+      } },
+    { "leafy", [](size_t) { return std::make_pair(size_t(4), size_t(16)); } },
+    { "bushy", [](size_t n) { return std::make_pair(std::max(size_t(1), n / 64), size_t(16)); } },
+};
+
+std::vector<Key>
+make_keys(size_t n, const Shape& shape, std::mt19937_64& rng)
+{
+    auto [f0, f1] = shape.fanout(n);
+    size_t f2     = std::max(size_t(1), (n + f0 * f1 - 1) / (f0 * f1));
+
+    std::vector<Key> keys;
+    keys.reserve(n);
+    for (uint32_t a = 0; a < f0 && keys.size() < n; ++a) {
+        for (uint32_t b = 0; b < f1 && keys.size() < n; ++b) {
+            for (uint32_t c = 0; c < f2 && keys.size() < n; ++c) {
+                keys.emplace_back(a, b, c);
+            }
+        }
+    }
+    std::shuffle(keys.begin(), keys.end(), rng);
+    return keys;
+}
+
+// Same keys with the element at the given level replaced by a value that is never inserted
+std::vector<Key>
+make_misses(const std::vector<Key>& keys, size_t level)
+{
+    std::vector<Key> misses(keys);
+    for (auto& k : misses) {
+        switch (level) {
+            case 0: std::get<0>(k) = ANY - 1; break;
+            case 1: std::get<1>(k) = ANY - 1; break;
+            default: std::get<2>(k) = ANY - 1; break;
+        }
+    }
+    return misses;
+}
+
+//-------------------------------------------------------------------------------------------------
+// Measurement
+//-------------------------------------------------------------------------------------------------
+struct Options
+{
+    size_t      min_size = 1000;
+    size_t      max_size = 1000000;
+    size_t      reps     = 3;
+    uint64_t    seed     = 42;
+    std::string filter;
+};
+
+volatile uint64_t sink;
+
+// Run setup and body reps times and report the fastest body execution
+template<typename SETUP, typename BODY>
+void
+measure(const Options&     opts,
+        const char*        bench,
+        const char*        container,
+        const char*        shape,
+        size_t             size,
+        size_t             ops,
+        SETUP&&            setup,
+        BODY&&             body)
+{
+    std::string name = std::string(bench) + '/' + container + '/' + shape;
+    if (!opts.filter.empty() && name.find(opts.filter) == std::string::npos) {
+        return;
+    }
+
+    double best = 0;
+    for (size_t r = 0; r < opts.reps; ++r) {
+        auto state = setup();
+        auto start = std::chrono::steady_clock::now();
+        sink       = body(state);
+        auto stop  = std::chrono::steady_clock::now();
+        auto ns    = std::chrono::duration<double, std::nano>(stop - start).count();
+        best       = r == 0 ? ns : std::min(best, ns);
+    }
+
+    std::cout << "{\"bench\":\"" << bench << "\",\"container\":\"" << container << "\",\"shape\":\"" << shape
+              << "\",\"size\":" << size << ",\"ops\":" << ops << ",\"reps\":" << opts.reps
+              << ",\"total_ns\":" << static_cast<uint64_t>(best) << ",\"ns_per_op\":" << best / ops << '}'
+              << std::endl;
+}
+
+template<typename C>
+C
+build(const std::vector<Key>& keys)
+{
+    C c;
+    for (const auto& k : keys) {
+        c.insert(k, std::get<2>(k) % 7);
+    }
+    return c;
+}
+
+template<typename C>
+void
+run(const Options& opts, const char* container, const Shape& shape, size_t size)
+{
+    std::mt19937_64 rng(opts.seed);
+    auto            keys  = make_keys(size, shape, rng);
+    auto            built = build<C>(keys);
+    auto            n     = keys.size();
+
+    measure(opts, "insert", container, shape.name, size, n, [] { return C(); }, [&](C& c) {
+        for (const auto& k : keys) {
+            c.insert(k, std::get<2>(k) % 7);
+        }
+        return n;
+    });
+
+    auto lookup = [&](const std::vector<Key>& qs) {
+        return [&, qs](const C* c) {
+            uint64_t hits = 0;
+            for (const auto& q : qs) {
+                hits += c->find(q) != nullptr;
+            }
+            return hits;
+        };
+    };
+
+    measure(opts, "find_hit", container, shape.name, size, n, [&] { return &built; }, lookup(keys));
+    measure(opts, "find_miss", container, shape.name, size, n, [&] { return &built; }, lookup(make_misses(keys, 2)));
+
+    // Populate every prefix so that a match can stop at any level
+    C prefixed = built;
+    for (const auto& k : keys) {
+        for (size_t depth = 0; depth < 3; ++depth) {
+            prefixed.insert_prefix(k, depth, depth);
+        }
+    }
+    for (size_t depth = 0; depth <= 3; ++depth) {
+        auto qs    = depth == 3 ? keys : make_misses(keys, depth);
+        auto bench = std::string("match_depth_") + std::to_string(depth);
+        measure(opts, bench.c_str(), container, shape.name, size, n, [&] { return &prefixed; }, [&](const C* c) {
+            uint64_t hits = 0;
+            for (const auto& q : qs) {
+                hits += c->match(q) != nullptr;
+            }
+            return hits;
+        });
+    }
+
+    auto order = keys;
+    std::shuffle(order.begin(), order.end(), rng);
+    measure(opts, "erase", container, shape.name, size, n, [&] { return built; }, [&](C& c) {
+        uint64_t count = 0;
+        for (const auto& k : order) {
+            count += c.erase(k);
+        }
+        return count;
+    });
+
+    measure(opts, "traverse", container, shape.name, size, n, [&] { return &built; }, [](const C* c) {
+        return c->traverse();
+    });
+
+    if (C().stream() > 0) {
+        measure(opts, "json_stream", container, shape.name, size, n, [&] { return &built; }, [](const C* c) {
+            return c->stream();
+        });
+        measure(opts, "json_writer", container, shape.name, size, n, [&] { return &built; }, [](const C* c) {
+            return c->write();
+        });
+    }
+
+    auto saved = built.save();
+    if (!saved.empty()) {
+        measure(opts, "binary_save", container, shape.name, size, n, [&] { return &built; }, [](const C* c) {
+            return c->save().size();
+        });
+        measure(opts, "binary_load", container, shape.name, size, n, [] { return C(); }, [&](C& c) {
+            return c.load(saved);
+        });
+    }
+
+    if (C().reduce()) {
+        measure(opts, "reduce", container, shape.name, size, n, [&] { return built; }, [](C& c) {
+            return static_cast<uint64_t>(c.reduce());
+        });
+    }
+}
+
+//-------------------------------------------------------------------------------------------------
+// Burst of leaf updates followed by one read of the grand total. The rollup is kept by climbing
+// every path by hand as in the aggregation example, by eager aggregates and by lazy aggregates.
+//-------------------------------------------------------------------------------------------------
+template<typename POLICY>
+using Rollup = O3::collection::basic_utriemap<POLICY, Data, uint32_t, uint32_t, uint32_t>;
+
+using Sum = O3::collection::sum_monoid<Data>;
+
+template<typename TM, typename UPDATE, typename TOTAL>
+void
+rollup(const Options&          opts,
+       const char*             bench,
+       const Shape&            shape,
+       const std::vector<Key>& keys,
+       UPDATE&&                update,
+       TOTAL&&                 total)
+{
+    TM built;
+    for (const auto& k : keys) {
+        auto [a, b, c] = k;
+        built.insert(0, a, b, c);
+        built.insert(0, a, b);
+        built.insert(0, a);
+    }
+    built.insert(0);
+
+    auto n = keys.size();
+    measure(opts, bench, "utriemap", shape.name, n, n, [&] { return built; }, [&](TM& tm) {
+        for (const auto& k : keys) {
+            std::apply([&](auto... ks) { update(tm, ks...); }, k);
+        }
+        return total(tm);
+    });
+}
+
+void
+rollups(const Options& opts, const Shape& shape, size_t size)
+{
+    std::mt19937_64 rng(opts.seed);
+    auto            keys = make_keys(size, shape, rng);
+
+    rollup<Rollup<O3::collection::policy>>(
+        opts,
+        "rollup_climb",
+        shape,
+        keys,
+        [](auto& tm, auto... ks) {
+            tm.climb_pre(
+                [](auto& n, auto&&...) {
+                    if (n) {
+                        *n += 1;
+                    }
+                    return true;
+                },
+                ks...);
+        },
+        [](const auto& tm) { return *tm.find(); });
+
+    auto update = [](auto& tm, auto... ks) { tm.update([](Data& d) { d += 1; }, ks...); };
+    auto total  = [](const auto& tm) { return *tm.aggregate(); };
+    rollup<Rollup<O3::collection::aggregate_policy<Sum>>>(opts, "rollup_eager", shape, keys, update, total);
+    rollup<Rollup<O3::collection::lazy_aggregate_policy<Sum>>>(opts, "rollup_lazy", shape, keys, update, total);
+
+    // Whole tree rollup in one pass
+    using Plain = Rollup<O3::collection::policy>;
+    Plain leaves;
+    for (const auto& k : keys) {
+        std::apply([&](auto... ks) { leaves.insert(1, ks...); }, k);
+    }
+    auto n = keys.size();
+    measure(opts, "fold_up", "utriemap", shape.name, n, n, [&] { return leaves; }, [](Plain& tm) {
+        O3::algo::fold_up(tm, std::plus<>());
+        return *tm.find();
+    });
+}
+
+//-------------------------------------------------------------------------------------------------
+// Reordering of prefix levels, user first. Traversing the source and inserting every element into
+// the target is compared with the sorted bulk build of pivot.
+//-------------------------------------------------------------------------------------------------
+template<typename TM>
+void
+pivots(const Options& opts, const char* container, const Shape& shape, size_t size)
+{
+    std::mt19937_64 rng(opts.seed);
+    auto            keys = make_keys(size, shape, rng);
+
+    TM src;
+    for (const auto& k : keys) {
+        std::apply([&](auto... ks) { src.insert(std::get<2>(k) % 7, ks...); }, k);
+    }
+
+    using Target = decltype(O3::algo::pivot<2, 0, 1>(src));
+    auto n       = src.size();
+    measure(opts, "pivot_insert", container, shape.name, n, n, [] { return 0; }, [&](int) {
+        Target   dst;
+        Key      path;
+        uint32_t depth = 0;
+        src.traverse_dfs(
+            [&](const auto& node, const auto&... ps) {
+                ((depth == 1 ? std::get<0>(path) = ps : depth == 2 ? std::get<1>(path) = ps : std::get<2>(path) = ps),
+                 ...);
+                if (node) {
+                    dst.insert(*node, std::get<2>(path), std::get<0>(path), std::get<1>(path));
+                }
+                ++depth;
+                return true;
+            },
+            [&](const auto&, const auto&...) {
+                --depth;
+                return true;
+            });
+        return dst.size();
+    });
+    measure(opts, "pivot", container, shape.name, n, n, [] { return 0; }, [&](int) {
+        return O3::algo::pivot<2, 0, 1>(src).size();
+    });
+}
+
+using OTrie = Trie<O3::collection::otriemap<Data, uint32_t, uint32_t, uint32_t>>;
+using UTrie = Trie<O3::collection::utriemap<Data, uint32_t, uint32_t, uint32_t>>;
+using OMap  = Flat<std::map<Key, Data>>;
+using UMap  = Flat<std::unordered_map<Key, Data, KeyHash>>;
+
+int
+main(int argc, char* argv[])
+{
+    Options opts;
+    for (int i = 1; i < argc; ++i) {
+        auto arg = [&](const char* name) { return std::strcmp(argv[i], name) == 0 && i + 1 < argc; };
+        if (arg("--min")) {
+            opts.min_size = std::stoul(argv[++i]);
+        } else if (arg("--max")) {
+            opts.max_size = std::stoul(argv[++i]);
+        } else if (arg("--reps")) {
+            opts.reps = std::max(1ul, std::stoul(argv[++i]));
+        } else if (arg("--seed")) {
+            opts.seed = std::stoull(argv[++i]);
+        } else if (arg("--filter")) {
+            opts.filter = argv[++i];
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--min N] [--max N] [--reps N] [--seed N] [--filter TEXT]\n";
+            return 1;
+        }
+    }
+
+    for (size_t size = opts.min_size; size <= opts.max_size; size *= 10) {
+        for (const auto& shape : shapes) {
+            run<OTrie>(opts, "otriemap", shape, size);
+            run<UTrie>(opts, "utriemap", shape, size);
+            run<OMap>(opts, "map", shape, size);
+            run<UMap>(opts, "unordered_map", shape, size);
+            rollups(opts, shape, size);
+            pivots<O3::collection::otriemap<Data, uint32_t, uint32_t, uint32_t>>(opts, "otriemap", shape, size);
+            pivots<O3::collection::utriemap<Data, uint32_t, uint32_t, uint32_t>>(opts, "utriemap", shape, size);
+        }
+    }
+    return 0;
+}
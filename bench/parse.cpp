@@ -0,0 +1,169 @@
+#include <iostream>
+#include <fstream>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <string>
+#include <random>
+#include <chrono>
+#include <algorithm>
+
+#include "triemap/triemap.h"
+#include "triemap/io/json.h"
+#include "triemap/io/json_reader.h"
+
+//-------------------------------------------------------------------------------------------------
+// Throughput of the streaming JSON reader. A three level trie-map is written to a file one
+// division at a time, so the file can be much larger than the memory needed to generate it,
+// and is then read back through a file stream. Results are printed as JSON objects per line.
+//-------------------------------------------------------------------------------------------------
+
+using Data = uint64_t;
+
+struct Options
+{
+    size_t      megabytes = 64;
+    size_t      fanout    = 256;
+    size_t      reps      = 3;
+    uint64_t    seed      = 42;
+    std::string file      = "parse_bench.json";
+    bool        keep      = false;
+};
+
+// Subtrie of one division, departments and users below it
+template<typename TM>
+using Division = typename TM::child_type;
+
+//-------------------------------------------------------------------------------------------------
+// Write divisions until the file reaches the requested size, return number of stored values
+//-------------------------------------------------------------------------------------------------
+template<typename TM>
+size_t
+generate(const Options& opts, O3::io::json::kind kind, std::mt19937_64& rng)
+{
+    const bool d3 = kind == O3::io::json::kind::d3;
+
+    std::ofstream os(opts.file, std::ios::binary | std::ios::trunc);
+    if (!os) {
+        throw std::runtime_error("Cannot open " + opts.file);
+    }
+
+    const size_t target = opts.megabytes << 20;
+    size_t       bytes  = 0;
+    size_t       values = 0;
+
+    O3::io::json::writer w(false);
+    auto                 flush = [&] {
+        os.write(w.str().data(), static_cast<std::streamsize>(w.size()));
+        bytes += w.size();
+        w.clear();
+    };
+
+    w.put(d3 ? "{\"children\":[" : "{");
+    for (uint32_t a = 0; bytes < target; ++a) {
+        Division<TM> division;
+        for (uint32_t b = 0; b < opts.fanout; ++b) {
+            for (uint32_t c = 0; c < opts.fanout; ++c) {
+                division.insert(rng() % 1000000, b, c);
+            }
+            division.insert(rng() % 1000000, b);
+        }
+        values += opts.fanout * (opts.fanout + 1);
+
+        O3::io::json::writer d(false);
+        d.write(division, kind);
+        if (a > 0) {
+            w.put(',');
+        }
+        if (d3) {
+            w.put("{\"name\":");
+            w.quoted(std::to_string(a));
+            w.put(',');
+            w.put(std::string_view(d.str()).substr(1));
+        } else {
+            w.quoted(std::to_string(a));
+            w.put(':');
+            w.put(d.str());
+        }
+        flush();
+    }
+    w.put(d3 ? "]}" : "}");
+    flush();
+    return values;
+}
+
+//-------------------------------------------------------------------------------------------------
+// Read the file back and report the fastest run
+//-------------------------------------------------------------------------------------------------
+template<typename TM>
+void
+bench(const Options& opts, const char* container, O3::io::json::kind kind)
+{
+    std::mt19937_64 rng(opts.seed);
+    size_t          values = generate<TM>(opts, kind, rng);
+    size_t          bytes  = 0;
+    double          best   = 0;
+
+    for (size_t rep = 0; rep < opts.reps; ++rep) {
+        std::ifstream is(opts.file, std::ios::binary);
+        is.seekg(0, std::ios::end);
+        bytes = static_cast<size_t>(is.tellg());
+        is.seekg(0);
+
+        TM   tm;
+        auto start = std::chrono::steady_clock::now();
+        O3::io::json::read(is, tm, kind);
+        auto stop = std::chrono::steady_clock::now();
+
+        if (tm.size() != values) {
+            throw std::runtime_error("Read back " + std::to_string(tm.size()) + " of " + std::to_string(values));
+        }
+        double seconds = std::chrono::duration<double>(stop - start).count();
+        best           = rep == 0 ? seconds : std::min(best, seconds);
+    }
+
+    std::cout << "{\"bench\":\"json_read\",\"container\":\"" << container << "\",\"kind\":\""
+              << (kind == O3::io::json::kind::d3 ? "d3" : "proper") << "\",\"bytes\":" << bytes
+              << ",\"values\":" << values << ",\"seconds\":" << best
+              << ",\"mb_per_s\":" << static_cast<double>(bytes) / (1 << 20) / best << "}" << std::endl;
+
+    if (!opts.keep) {
+        std::remove(opts.file.c_str());
+    }
+}
+
+using OTrie = O3::collection::otriemap<Data, uint32_t, uint32_t, uint32_t>;
+using UTrie = O3::collection::utriemap<Data, uint32_t, uint32_t, uint32_t>;
+
+int
+main(int argc, char* argv[])
+{
+    Options opts;
+    for (int i = 1; i < argc; ++i) {
+        auto arg = [&](const char* name) { return std::strcmp(argv[i], name) == 0 && i + 1 < argc; };
+        if (arg("--mb")) {
+            opts.megabytes = std::max(1ul, std::stoul(argv[++i]));
+        } else if (arg("--fanout")) {
+            opts.fanout = std::max(1ul, std::stoul(argv[++i]));
+        } else if (arg("--reps")) {
+            opts.reps = std::max(1ul, std::stoul(argv[++i]));
+        } else if (arg("--seed")) {
+            opts.seed = std::stoull(argv[++i]);
+        } else if (arg("--file")) {
+            opts.file = argv[++i];
+        } else if (std::strcmp(argv[i], "--keep") == 0) {
+            opts.keep = true;
+        } else {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--mb N] [--fanout N] [--reps N] [--seed N] [--file PATH] [--keep]\n";
+            return 1;
+        }
+    }
+
+    using O3::io::json::kind;
+    bench<OTrie>(opts, "otriemap", kind::proper);
+    bench<UTrie>(opts, "utriemap", kind::proper);
+    bench<OTrie>(opts, "otriemap", kind::d3);
+    bench<UTrie>(opts, "utriemap", kind::d3);
+    return 0;
+}
@@ -0,0 +1,211 @@
+#include <iostream>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <tuple>
+#include <random>
+#include <chrono>
+#include <algorithm>
+
+#include "triemap/triemap.h"
+#include "triemap/product.h"
+
+//-------------------------------------------------------------------------------------------------
+// Two-dimensional trie-maps. The geography by organization example is stored as an outer
+// trie-map whose data are inner trie-maps, and as one flattened product trie-map. Memory use,
+// find and match are compared. Results are printed as JSON objects per line.
+//-------------------------------------------------------------------------------------------------
+
+using Data  = uint64_t;
+using Key   = uint32_t;
+using Pair  = std::tuple<Key, Key>;
+using Query = std::pair<Pair, Pair>;
+
+struct Options
+{
+    size_t   outer = 32;  // Fan-out of both outer levels
+    size_t   inner = 64;  // Fan-out of both inner levels
+    size_t   per   = 64;  // Inner paths per outer path
+    size_t   ops   = 1000000;
+    size_t   reps  = 3;
+    uint64_t seed  = 42;
+};
+
+template<template<typename K, typename T> class MAP>
+struct Nested
+{
+    using Inner = O3::collection::details::triemap<MAP, O3::collection::policy, Data, Key, Key>;
+    using Outer = O3::collection::details::triemap<MAP, O3::collection::policy, Inner, Key, Key>;
+
+    Outer tm;
+
+    void insert(Data d, const Pair& o, const Pair& i)
+    {
+        auto [o0, o1] = o;
+        auto [i0, i1] = i;
+        tm.insert(Inner(), o0, o1).first->insert(d, i0, i1);
+    }
+    void insert(Data d, Key o0, const Pair& i)
+    {
+        auto [i0, i1] = i;
+        tm.insert(Inner(), o0).first->insert(d, i0, i1);
+    }
+    const Data* find(const Pair& o, const Pair& i) const
+    {
+        auto inner = tm.find(std::get<0>(o), std::get<1>(o));
+        return inner ? inner->find(std::get<0>(i), std::get<1>(i)) : nullptr;
+    }
+    // Collect inner trie-maps along the outer path, then match in them from the deepest one
+    const Data* match(const Pair& o, const Pair& i) const
+    {
+        const Inner* inners[3];
+        size_t       n = 0;
+        tm.climb_pre(
+            [&](const auto& node, auto&&...) {
+                if (node) {
+                    inners[n++] = &*node;
+                }
+                return true;
+            },
+            std::get<0>(o),
+            std::get<1>(o));
+        while (n > 0) {
+            if (auto d = inners[--n]->match(std::get<0>(i), std::get<1>(i))) {
+                return d;
+            }
+        }
+        return nullptr;
+    }
+    O3::collection::statistics stats() const
+    {
+        auto st = tm.stats();
+        tm.traverse_pre([&](const auto& n, auto&&...) {
+            if (n) {
+                auto is = (*n).stats();
+                st.repo_bytes += is.repo_bytes;
+                st.data_bytes += is.data_bytes;
+                st.allocations += is.allocations;
+            }
+            return true;
+        });
+        return st;
+    }
+};
+
+template<template<typename K, typename T> class MAP>
+struct Flat
+{
+    O3::collection::product<MAP, O3::collection::policy, Data, Pair, Pair> tm;
+
+    void insert(Data d, const Pair& o, const Pair& i)
+    {
+        tm.insert(d, o, i);
+    }
+    void insert(Data d, Key o0, const Pair& i)
+    {
+        tm.insert(d, std::make_tuple(o0), i);
+    }
+    const Data* find(const Pair& o, const Pair& i) const
+    {
+        return tm.find(o, i);
+    }
+    const Data* match(const Pair& o, const Pair& i) const
+    {
+        return tm.match(o, i);
+    }
+    O3::collection::statistics stats() const
+    {
+        return tm.trie().stats();
+    }
+};
+
+volatile uint64_t sink;
+
+template<typename C>
+void
+run(const Options& opts, const char* container)
+{
+    std::mt19937_64 rng(opts.seed);
+    auto            pick = [&](size_t n) { return static_cast<Key>(rng() % n); };
+
+    // Every outer path holds some inner paths, every continent a few defaults for its countries
+    C                  c;
+    std::vector<Query> hits;
+    for (Key o0 = 0; o0 < opts.outer; ++o0) {
+        for (size_t i = 0; i < opts.per / 4; ++i) {
+            c.insert(rng(), o0, Pair(pick(opts.inner), pick(opts.inner)));
+        }
+        for (Key o1 = 0; o1 < opts.outer; ++o1) {
+            for (size_t i = 0; i < opts.per; ++i) {
+                Pair in(pick(opts.inner), pick(opts.inner));
+                c.insert(rng(), Pair(o0, o1), in);
+                hits.emplace_back(Pair(o0, o1), in);
+            }
+        }
+    }
+
+    std::vector<Query> finds, matches;
+    for (size_t i = 0; i < opts.ops; ++i) {
+        finds.push_back(hits[rng() % hits.size()]);
+        matches.emplace_back(Pair(pick(opts.outer), pick(opts.outer)), Pair(pick(opts.inner), pick(opts.inner)));
+    }
+
+    auto st = c.stats();
+    std::cout << "{\"bench\":\"memory\",\"container\":\"" << container << "\",\"outer\":" << opts.outer
+              << ",\"inner\":" << opts.inner << ",\"per\":" << opts.per << ",\"bytes\":" << st.bytes() << ",\"allocations\":" << st.allocations << '}' << std::endl;
+
+    auto measure = [&](const char* bench, const std::vector<Query>& queries, auto&& lookup) {
+        double   best  = 0;
+        uint64_t found = 0;
+        for (size_t r = 0; r < opts.reps; ++r) {
+            found      = 0;
+            auto start = std::chrono::steady_clock::now();
+            for (const auto& q : queries) {
+                auto d = lookup(q.first, q.second);
+                found += d ? *d : 0;
+            }
+            auto ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+            best    = r == 0 ? ns : std::min(best, ns);
+        }
+        sink = found;
+        std::cout << "{\"bench\":\"" << bench << "\",\"container\":\"" << container << "\",\"outer\":" << opts.outer
+                  << ",\"inner\":" << opts.inner << ",\"per\":" << opts.per << ",\"ops\":" << queries.size()
+                  << ",\"reps\":" << opts.reps << ",\"total_ns\":" << static_cast<uint64_t>(best)
+                  << ",\"ns_per_op\":" << best / static_cast<double>(queries.size()) << '}' << std::endl;
+    };
+    measure("find", finds, [&](const Pair& o, const Pair& i) { return c.find(o, i); });
+    measure("match", matches, [&](const Pair& o, const Pair& i) { return c.match(o, i); });
+}
+
+int
+main(int argc, char* argv[])
+{
+    Options opts;
+    for (int i = 1; i < argc; ++i) {
+        auto arg = [&](const char* name) { return std::strcmp(argv[i], name) == 0 && i + 1 < argc; };
+        if (arg("--outer")) {
+            opts.outer = std::max(1ul, std::stoul(argv[++i]));
+        } else if (arg("--inner")) {
+            opts.inner = std::max(1ul, std::stoul(argv[++i]));
+        } else if (arg("--per")) {
+            opts.per = std::max(1ul, std::stoul(argv[++i]));
+        } else if (arg("--ops")) {
+            opts.ops = std::max(1ul, std::stoul(argv[++i]));
+        } else if (arg("--reps")) {
+            opts.reps = std::max(1ul, std::stoul(argv[++i]));
+        } else if (arg("--seed")) {
+            opts.seed = std::stoull(argv[++i]);
+        } else {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--outer N] [--inner N] [--per N] [--ops N] [--reps N] [--seed N]\n";
+            return 1;
+        }
+    }
+
+    run<Nested<O3::collection::omap>>(opts, "nested_otriemap");
+    run<Flat<O3::collection::omap>>(opts, "oproduct");
+    run<Nested<O3::collection::umap>>(opts, "nested_utriemap");
+    run<Flat<O3::collection::umap>>(opts, "uproduct");
+    return 0;
+}
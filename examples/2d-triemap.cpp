@@ -4,8 +4,11 @@
 #include <map>
 #include <type_traits>
 #include <utility>
+#include <tuple>
+#include <cassert>
 
 #include "triemap/triemap.h"
+#include "triemap/product.h"
 #include "triemap/io/json.h"
 
 // Data element
@@ -130,8 +133,12 @@ struct O3::io::json::traits<Data>
 using OrgTrieMap    = O3::collection::otriemap<Data, Division, Department>;
 using GeoOrgTrieMap = O3::collection::otriemap<OrgTrieMap, Continent, Country>;
 
+// The same domain flattened into one trie-map, outer geographical levels followed by organizational ones
+using GeoOrgProduct = O3::collection::oproduct<Data, std::tuple<Continent, Country>, std::tuple<Division, Department>>;
+
 // Global instances for simplicity
 GeoOrgTrieMap GOTM;
+GeoOrgProduct GOP;
 
 int
 main(int argc, char* argv[])
@@ -147,5 +154,32 @@ main(int argc, char* argv[])
     std::cout << "\n\n2D ordered triemap as a proper JSON object.\n" << O3::io::json::proper(GOTM) << std::endl;
     std::cout << "\n\n2D ordered triemap as a D3 JSON object.\n" << O3::io::json::d3(GOTM) << std::endl;
 
+    // Flattened form takes both paths in a single call, and geography can stop above the country level
+    GOP.insert(Data('A'), std::make_tuple(Continent("Europe"), Country("Ukraine")), std::make_tuple(Division("Sales"), Department("Retail")));
+    GOP.insert(Data('B'), std::make_tuple(Continent("Europe"), Country("Germany")), std::make_tuple(Division("Services"), Department("Support")));
+    GOP.insert(Data('C'), std::make_tuple(Continent("Europe"), Country("Germany")), std::make_tuple(Division("Services"), Department("Consulting")));
+    GOP.insert(Data('D'), std::make_tuple(Continent("Europe")), std::make_tuple(Division("Services")));
+    GOP.insert(Data('E'), std::make_tuple(Continent("Europe"), Country("Germany")), std::make_tuple(Division("Services")));
+    GOP.insert(Data('F'), std::make_tuple(Continent("Europe")), std::make_tuple(Division("Services"), Department("Repairs")));
+
+    auto germany = std::make_tuple(Continent("Europe"), Country("Germany"));
+    auto france  = std::make_tuple(Continent("Europe"), Country("France"));
+    auto support = std::make_tuple(Division("Services"), Department("Support"));
+    auto repairs = std::make_tuple(Division("Services"), Department("Repairs"));
+
+    assert(*GOP.find(germany, support) == *GOTM.find(Continent("Europe"), Country("Germany"))->find(Division("Services"), Department("Support")));
+    assert(*GOP.match(germany, support) == Data('B'));
+    assert(*GOP.match(germany, repairs) == Data('E'));
+    assert(*GOP.match(france, support) == Data('D'));
+
+    // By default the country level outranks the department level, the precedence can turn this around
+    assert(*GOP.match(germany, repairs, O3::collection::inner_first()) == Data('F'));
+
+    std::cout << "\n\nFlattened 2D triemap lookups.\n";
+    std::cout << "Germany, Support: " << *GOP.match(germany, support) << std::endl;
+    std::cout << "Germany, Repairs: " << *GOP.match(germany, repairs) << std::endl;
+    std::cout << "France, Support: " << *GOP.match(france, support) << std::endl;
+    std::cout << "Germany, Repairs, department first: " << *GOP.match(germany, repairs, O3::collection::inner_first()) << std::endl;
+
     return 0;
 }
@@ -66,13 +66,36 @@ operator<<(std::ostream& os, const Limit& l)
     return os;
 }
 
+// Utilization of users rolls up into their department, division and the whole organization
+struct Utilization
+{
+    using value_type = size_t;
+
+    static size_t identity()
+    {
+        return 0;
+    }
+    static size_t lift(const Limit& l)
+    {
+        return l.utilization;
+    }
+    static size_t combine(size_t a, size_t b)
+    {
+        return a + b;
+    }
+};
+
 // We will keep track of resource utilization at the division, department and user level.
 using Division   = std::string;
 using Department = std::string;
 using Id         = std::string;
 
-// To achieve this we will store Limits at division, department and user level.
-using Limits     = O3::collection::utriemap<Limit, Division, Department, Id>;
+// To achieve this we will store Limits at division, department and user level. Users record what they use, and the
+// trie-map keeps the totals of every subtree. They are recomputed lazily, only for the subtrees that changed. Unlike
+// updating every limit along the path, this leaves the utilization stored at division, department and global level at
+// zero, and their rolled-up utilization is read from the aggregates instead.
+using Limits = O3::collection::
+    basic_utriemap<O3::collection::lazy_aggregate_policy<Utilization>, Limit, Division, Department, Id>;
 
 // Global instance for simplicity
 Limits GL;
@@ -80,31 +103,37 @@ Limits GL;
 void
 acquire(const Person& person, const Resource& resource)
 {
-    GL.climb_pre(
-        [&](auto& n, auto&&...) {
-            if (n) {
-                *n += resource;
-            }
-            return true;
-        },
-        person.division,
-        person.department,
-        person.id);
+    GL.update([&](Limit& l) { l += resource; }, person.division, person.department, person.id);
 }
 
 void
 release(const Person& person, const Resource& resource)
 {
-    GL.climb_pre(
-        [&](auto& n, auto&&...) {
-            if (n) {
-                *n -= resource;
-            }
-            return true;
-        },
-        person.division,
-        person.department,
-        person.id);
+    GL.update([&](Limit& l) { l -= resource; }, person.division, person.department, person.id);
+}
+
+// Utilization of the subtree given the list of prefixes
+template<typename... PS>
+size_t
+utilization(PS&&... ps)
+{
+    return *GL.aggregate(std::forward<PS>(ps)...);
+}
+
+// Limits of all people with the rolled-up utilization at every level, as shown in the verbose output
+template<size_t N>
+O3::collection::utriemap<Limit, Division, Department, Id>
+rolled_up(const Person (&people)[N])
+{
+    O3::collection::utriemap<Limit, Division, Department, Id> limits;
+    auto limit = [](const auto&... ps) { return Limit(GL.find(ps...)->threshold, utilization(ps...)); };
+    limits.insert(limit());
+    for (const auto& p : people) {
+        limits.insert(limit(p.division), p.division);
+        limits.insert(limit(p.division, p.department), p.division, p.department);
+        limits.insert(limit(p.division, p.department, p.id), p.division, p.department, p.id);
+    }
+    return limits;
 }
 
 int
@@ -130,7 +159,7 @@ main(int argc, char* argv[])
     GL.insert(Limit(10 * 100 * 100 * 1000));
 
     if (verbose) {
-        std::cout << "Initial:\n" << GL << std::endl;
+        std::cout << "Initial:\n" << rolled_up(people) << std::endl;
     }
 
     // Two nodes for person, three for department and two for division, plus a global one
@@ -141,22 +170,28 @@ main(int argc, char* argv[])
         acquire(person, { 100 });
     }
 
+    // Roll up the burst of updates now rather than on the first read
+    GL.refresh();
+
     // Verify that utilization levels have been properly updated
-    assert(GL.find("Sales", "Retail", "001")->utilization == 100);
-    assert(GL.find("Sales", "Retail")->utilization == 100);
-    assert(GL.find("Sales")->utilization == 100);
+    assert(utilization("Sales", "Retail", "001") == 100);
+    assert(utilization("Sales", "Retail") == 100);
+    assert(utilization("Sales") == 100);
+
+    assert(utilization("Services", "Support", "002") == 100);
+    assert(utilization("Services", "Support", "003") == 100);
+    assert(utilization("Services", "Consulting", "004") == 100);
+    assert(utilization("Services", "Support") == 200);
+    assert(utilization("Services", "Consulting") == 100);
+    assert(utilization("Services") == 300);
 
-    assert(GL.find("Services", "Support", "002")->utilization == 100);
-    assert(GL.find("Services", "Support", "003")->utilization == 100);
-    assert(GL.find("Services", "Consulting", "004")->utilization == 100);
-    assert(GL.find("Services", "Support")->utilization == 200);
-    assert(GL.find("Services", "Consulting")->utilization == 100);
-    assert(GL.find("Services")->utilization == 300);
+    assert(utilization() == 400);
 
-    assert(GL.find()->utilization == 400);
+    // Only users hold their own utilization
+    assert(GL.find("Services", "Support", "002")->utilization == 100 && GL.find("Services")->utilization == 0);
 
     if (verbose) {
-        std::cout << "After acquire:\n" << GL << std::endl;
+        std::cout << "After acquire:\n" << rolled_up(people) << std::endl;
     }
 
     // Everybody releases half of the amount they acquired.
@@ -164,21 +199,21 @@ main(int argc, char* argv[])
         release(person, { 50 });
     }
 
-    assert(GL.find("Sales", "Retail", "001")->utilization == 50);
-    assert(GL.find("Sales", "Retail")->utilization == 50);
-    assert(GL.find("Sales")->utilization == 50);
+    assert(utilization("Sales", "Retail", "001") == 50);
+    assert(utilization("Sales", "Retail") == 50);
+    assert(utilization("Sales") == 50);
 
-    assert(GL.find("Services", "Support", "002")->utilization == 50);
-    assert(GL.find("Services", "Support", "003")->utilization == 50);
-    assert(GL.find("Services", "Consulting", "004")->utilization == 50);
-    assert(GL.find("Services", "Support")->utilization == 100);
-    assert(GL.find("Services", "Consulting")->utilization == 50);
-    assert(GL.find("Services")->utilization == 150);
+    assert(utilization("Services", "Support", "002") == 50);
+    assert(utilization("Services", "Support", "003") == 50);
+    assert(utilization("Services", "Consulting", "004") == 50);
+    assert(utilization("Services", "Support") == 100);
+    assert(utilization("Services", "Consulting") == 50);
+    assert(utilization("Services") == 150);
 
-    assert(GL.find()->utilization == 200);
+    assert(utilization() == 200);
 
     if (verbose) {
-        std::cout << "After first release:\n" << GL << std::endl;
+        std::cout << "After first release:\n" << rolled_up(people) << std::endl;
     }
 
     // Everybody releases the remaining amount.
@@ -187,21 +222,21 @@ main(int argc, char* argv[])
     }
 
     // Verify that utilization goes to zero everywhere.
-    assert(GL.find("Sales", "Retail", "001")->utilization == 0);
-    assert(GL.find("Sales", "Retail")->utilization == 0);
-    assert(GL.find("Sales")->utilization == 0);
+    assert(utilization("Sales", "Retail", "001") == 0);
+    assert(utilization("Sales", "Retail") == 0);
+    assert(utilization("Sales") == 0);
 
-    assert(GL.find("Services", "Support", "002")->utilization == 0);
-    assert(GL.find("Services", "Support", "003")->utilization == 0);
-    assert(GL.find("Services", "Consulting", "004")->utilization == 0);
-    assert(GL.find("Services", "Support")->utilization == 0);
-    assert(GL.find("Services", "Consulting")->utilization == 0);
-    assert(GL.find("Services")->utilization == 0);
+    assert(utilization("Services", "Support", "002") == 0);
+    assert(utilization("Services", "Support", "003") == 0);
+    assert(utilization("Services", "Consulting", "004") == 0);
+    assert(utilization("Services", "Support") == 0);
+    assert(utilization("Services", "Consulting") == 0);
+    assert(utilization("Services") == 0);
 
-    assert(GL.find()->utilization == 0);
+    assert(utilization() == 0);
 
     if (verbose) {
-        std::cout << "After second release:\n" << GL << std::endl;
+        std::cout << "After second release:\n" << rolled_up(people) << std::endl;
     }
 
     std::cout << "All good." << std::endl;
@@ -4,6 +4,7 @@
 #include <ostream>
 
 #include "triemap/triemap.h"
+#include "triemap/expiring.h"
 #include "triemap/io/json.h"
 
 struct Person
@@ -75,6 +76,19 @@ main(int argc, char* argv[])
     ff.insert(false, feature, "Services", "Consulting");
     checkFeature(feature, ff);
 
+    // A temporary override lets one consultant try the feature for an hour, counted in minutes
+    O3::collection::expiring<FeatureFlags> tff;
+    tff.insert(true, feature);
+    tff.insert(false, feature, "Services", "Consulting");
+    tff.insert_for(60, true, feature, "Services", "Consulting", "004");
+    checkFeature(feature, tff.trie());
+
+    tff.advance(30);
+    assert(tff.find(feature, "Services", "Consulting", "004") != nullptr);
+    tff.advance(60);
+    assert(tff.find(feature, "Services", "Consulting", "004") == nullptr && tff.pending() == 0);
+    checkFeature(feature, tff.trie());
+
     if (verbose) {
         std::cout << "Feature flags:\n" << ff << std::endl;
         std::cout << "Feature flags as D3:\n" << O3::io::json::d3(ff) << std::endl;
@@ -77,6 +77,11 @@ main(int, char*[])
     std::cout << "\n\nOrdered triemap as a proper JSON object.\n" << O3::io::json::proper(o) << std::endl;
     std::cout << "\n\nOrdered triemap as a D3 JSON object.\n" << O3::io::json::d3(o) << std::endl;
 
+    // Buffered writer produces the same output much faster and can leave out the whitespace
+    O3::io::json::writer w(false);
+    std::cout << "\n\nOrdered triemap as a compact proper JSON object.\n"
+              << w.write(o, O3::io::json::kind::proper).str() << std::endl;
+
     std::cout << std::endl;
     return 0;
 }
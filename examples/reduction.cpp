@@ -8,6 +8,7 @@
 #include <functional>
 
 #include "triemap/triemap.h"
+#include "triemap/indexed.h"
 #include "triemap/io/json.h"
 
 // User will have their own configuration represented as a number. Different users may share the same configuration.
@@ -126,6 +127,8 @@ main(int argc, char* argv[])
     // Initialize both collections
     fill(FM, TM, verbose);
     std::cout << "Flat map size=" << FM.size() << ' ' << "Trie map size=" << TM.size() << std::endl;
+    auto stats = TM.stats();
+    std::cout << "Trie map nodes=" << stats.nodes() << ' ' << "bytes=" << stats.bytes() << std::endl;
 
     if (verbose) {
         std::cout << "Before reduction:\n" << TM << std::endl;
@@ -138,12 +141,29 @@ main(int argc, char* argv[])
     reduce(TM);
     std::cout << "Reduced trie map size=" << TM.size() << std::endl;
 
+    // Show how much memory the reduction saved
+    stats = TM.stats();
+    std::cout << "Reduced trie map nodes=" << stats.nodes() << ' ' << "bytes=" << stats.bytes() << ' '
+              << "allocations=" << stats.allocations << std::endl;
+
     if (verbose) {
         std::cout << "After reduction:\n" << TM << std::endl;
     }
 
     verify(FM, TM);
 
+    // Audit which key paths hold each configuration. The index answers without traversing the trie map.
+    O3::collection::indexed<TrieMap> audit(TM);
+    for (int config = 1; config <= 4; ++config) {
+        size_t holders = 0;
+        audit.paths({ config }, [&](auto... ps) {
+            assert(audit.find(ps...)->config == config);
+            ++holders;
+        });
+        assert(holders == audit.count({ config }));
+        std::cout << "Configuration " << config << " held by " << holders << " key paths" << std::endl;
+    }
+
     std::cout << "All good." << std::endl;
     return 0;
 }
@@ -0,0 +1,345 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <stdexcept>
+
+#include "triemap/triemap.h"
+#include "triemap/algo/diff.h"
+#include "triemap/algo/merge.h"
+#include "triemap/algo/fold.h"
+#include "triemap/algo/pivot.h"
+
+//-------------------------------------------------------------------------------------------------
+// Return differences as a string of change kind, data before and after, and key path per line
+//-------------------------------------------------------------------------------------------------
+template<typename REPO>
+std::string
+differences(const REPO& a, const REPO& b)
+{
+    std::string result;
+    O3::algo::diff(a, b, [&](O3::algo::change c, const char* before, const char* after, const auto&... ps) {
+        result += c == O3::algo::change::added ? '+' : c == O3::algo::change::removed ? '-' : '~';
+        result += before ? *before : '.';
+        result += after ? *after : '.';
+        ((result += '/', result += ps), ...);
+        result += '\n';
+    });
+    return result;
+}
+
+//-------------------------------------------------------------------------------------------------
+// Test differences between two collections
+//-------------------------------------------------------------------------------------------------
+template<typename REPO>
+void
+test_diff()
+{
+    REPO a;
+    a.insert('0');
+    a.insert('A', "a");
+    a.insert('C', "a", "c");
+    a.insert('D', "a", "d");
+    a.insert('E', "e", "x");
+    a.insert('F', "e", "y");
+
+    REPO b = a;
+    assert(differences(a, b).empty());
+
+    b.erase();
+    b.insert('1');
+    b.erase("a", "c");
+    b.insert('G', "a", "g");
+    b.erase("e", "x");
+    b.erase("e", "y");
+    b.insert('H', "h", "h");
+    b.update([](char& d) { d = 'd'; }, "a", "d");
+
+    assert(differences(a, b) == "~01\n-C./a/c\n~Dd/a/d\n+.G/a/g\n-E./e/x\n-F./e/y\n+.H/h/h\n");
+    assert(differences(b, a) == "~10\n~dD/a/d\n-G./a/g\n+.C/a/c\n-H./h/h\n+.E/e/x\n+.F/e/y\n");
+}
+
+// Count visited nodes to show that identical subtrees are skipped
+struct counting_char
+{
+    static inline size_t compared = 0;
+
+    char value;
+
+    bool operator==(const counting_char& oth) const
+    {
+        ++compared;
+        return value == oth.value;
+    }
+};
+
+template<>
+struct std::hash<counting_char>
+{
+    size_t operator()(const counting_char& c) const
+    {
+        return std::hash<char>()(c.value);
+    }
+};
+
+void
+test_diff_skips_identical_subtrees()
+{
+    using repo = O3::collection::basic_otriemap<O3::collection::hashed_policy, counting_char, int, int>;
+    repo a;
+    for (int i = 0; i < 100; ++i) {
+        for (int j = 0; j < 100; ++j) {
+            a.insert(counting_char{ 'x' }, i, j);
+        }
+    }
+    repo b = a;
+    b.update([](counting_char& d) { d.value = 'y'; }, 42, 7);
+
+    size_t changes = 0;
+    counting_char::compared = 0;
+    O3::algo::diff(a, b, [&](O3::algo::change c, const auto*, const auto*, const auto&... ps) {
+        assert(c == O3::algo::change::changed && sizeof...(ps) == 2);
+        assert(((ps == 42 || ps == 7) && ...));
+        ++changes;
+    });
+    assert(changes == 1 && counting_char::compared == 1);
+}
+
+//-------------------------------------------------------------------------------------------------
+// Test merge with every collision policy
+//-------------------------------------------------------------------------------------------------
+template<typename REPO>
+void
+test_merge(size_t threads)
+{
+    auto base = [] {
+        REPO r;
+        r.insert('0', "a");
+        r.insert('1', "a", "b");
+        r.insert('2', "c", "d");
+        return r;
+    };
+    auto overlay = [] {
+        REPO r;
+        r.insert('X', "a", "b");
+        r.insert('Y', "a", "e");
+        r.insert('Z', "f", "g");
+        r.insert('W');
+        return r;
+    };
+
+    REPO expected;
+    expected.insert('W');
+    expected.insert('0', "a");
+    expected.insert('1', "a", "b");
+    expected.insert('Y', "a", "e");
+    expected.insert('2', "c", "d");
+    expected.insert('Z', "f", "g");
+
+    REPO dst = base();
+    REPO src = overlay();
+    O3::algo::merge(dst, std::move(src), O3::algo::keep(), threads);
+    assert(dst == expected && src.empty() && src.leaf());
+
+    dst = base();
+    O3::algo::merge(dst, overlay(), O3::algo::overwrite(), threads);
+    expected.update([](char& d) { d = 'X'; }, "a", "b");
+    assert(dst == expected);
+
+    dst = base();
+    O3::algo::merge(dst, overlay(), O3::algo::combine([](char d, char s) { return d < s ? d : s; }), threads);
+    expected.update([](char& d) { d = '1'; }, "a", "b");
+    assert(dst == expected);
+}
+
+// Subtrees missing in the destination are spliced, their elements stay where they are
+template<typename REPO>
+void
+test_merge_splices()
+{
+    REPO dst;
+    dst.insert('A', "a", "a");
+
+    REPO src;
+    src.insert('B', "b", "b");
+    src.insert('C', "a", "c");
+    const char* b = src.find("b", "b");
+    const char* c = src.find("a", "c");
+
+    dst.merge(std::move(src), O3::algo::keep());
+    assert(dst.find("b", "b") == b && dst.find("a", "c") == c && dst.size() == 3);
+}
+
+//-------------------------------------------------------------------------------------------------
+// Test bottom-up and top-down folds and path scans of numbers
+//-------------------------------------------------------------------------------------------------
+template<typename REPO>
+void
+test_fold()
+{
+    REPO r;
+    r.insert(10, "a");
+    r.insert(1, "a", "x");
+    r.insert(2, "a", "y");
+    r.insert(5, "b", "z");
+    for (int i = 0; i < 20; ++i) {
+        r.insert(i, "c", std::to_string(i));
+    }
+
+    // Long runs of children are folded in several lanes
+    O3::algo::fold_up(r, std::plus<>());
+    assert(*r.find("a") == 13 && *r.find("b") == 5 && *r.find("c") == 190 && *r.find() == 208);
+    assert(*r.find("a", "x") == 1 && *r.find("c", "7") == 7 && r.size() == 27);
+
+    REPO m = r;
+    O3::algo::fold_up(m, [](int a, int b) { return std::max(a, b); });
+    assert(*m.find() == 208 && *m.find("c") == 190);
+
+    // Defaults flow down into nodes without data
+    REPO d;
+    d.insert(7);
+    d.insert(3, "a", "x");
+    d.insert(4, "b", "y");
+    REPO o = d;
+    O3::algo::fold_down(d);
+    assert(*d.find("a") == 7 && *d.find("b") == 7 && *d.find("a", "x") == 3 && *d.find("b", "y") == 4);
+    O3::algo::fold_down(o, std::plus<>());
+    assert(*o.find("a") == 7 && *o.find("a", "x") == 10 && *o.find("b", "y") == 11 && *o.find() == 7);
+
+    // Scans skip nodes without data
+    REPO s;
+    s.insert(7);
+    s.insert(3, "a", "x");
+    s.insert(1, "b");
+    s.insert(4, "b", "y");
+    O3::algo::scan(s, std::plus<>());
+    assert(s.find("a") == nullptr && *s.find("a", "x") == 10 && *s.find("b") == 8 && *s.find("b", "y") == 12);
+}
+
+// Data that is not arithmetic is folded child by child in container order
+void
+test_fold_strings()
+{
+    O3::collection::otriemap<std::string, std::string, std::string> r;
+    r.insert("x", "a", "1");
+    r.insert("y", "a", "2");
+    r.insert("z", "b", "1");
+    O3::algo::fold_up(r, std::plus<>());
+    assert(*r.find("a") == "xy" && *r.find() == "xyz");
+
+    O3::algo::fold_down(r, [](const std::string& p, const std::string& c) { return p + '.' + c; });
+    assert(*r.find("a") == "xyz.xy" && *r.find("a", "2") == "xyz.xy.y");
+}
+
+// Boolean flags are folded child by child as well
+void
+test_fold_flags()
+{
+    O3::collection::otriemap<bool, std::string, std::string> r;
+    for (int i = 0; i < 20; ++i) {
+        r.insert(i == 13, "a", std::to_string(i));
+        r.insert(false, "b", std::to_string(i));
+    }
+    O3::algo::fold_up(r, std::logical_or<>());
+    assert(*r.find("a") && !*r.find("b") && *r.find() && r.size() == 43);
+
+    O3::algo::fold_up(r, std::logical_and<>());
+    assert(!*r.find("a") && !*r.find("b") && !*r.find() && *r.find("a", "13"));
+}
+
+//-------------------------------------------------------------------------------------------------
+// Test reordering of prefix levels
+//-------------------------------------------------------------------------------------------------
+template<typename REPO>
+void
+test_pivot()
+{
+    REPO r;
+    r.insert(1, "a", 'x', 10);
+    r.insert(2, "a", 'x', 20);
+    r.insert(3, "a", 'y', 10);
+    r.insert(4, "b", 'x', 10);
+    for (int i = 0; i < 20; ++i) {
+        r.insert(100 + i, "c", 'z', i);
+    }
+
+    auto p = O3::algo::pivot<2, 0, 1>(r);
+    static_assert(std::is_same_v<typename decltype(p)::prefix_type, int>);
+    assert(p.size() == r.size() && r.size() == 24);
+    assert(*p.find(10, "a", 'x') == 1 && *p.find(20, "a", 'x') == 2 && *p.find(10, "a", 'y') == 3);
+    assert(*p.find(10, "b", 'x') == 4 && *p.find(7, "c", 'z') == 107 && *p.find(10, "c", 'z') == 110);
+    assert(p.find(10, "c", 'y') == nullptr);
+    assert((O3::algo::pivot<1, 2, 0>(p) == r));
+
+    // Data above the last level stays where its prefixes still lead the path
+    r.insert(5);
+    r.insert(6, "a", 'x');
+    auto q = O3::algo::pivot<1, 0, 2>(r);
+    assert(*q.find() == 5 && *q.find('x', "a") == 6 && *q.find('x', "a", 20) == 2 && q.size() == 26);
+
+    r.insert(7, "a");
+    bool thrown = false;
+    try {
+        O3::algo::pivot<1, 0, 2>(r);
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    assert(thrown);
+
+    // Data is moved out of an rvalue source
+    auto m = O3::algo::pivot<0, 1, 2>(std::move(r));
+    assert(*m.find("a") == 7 && *m.find("c", 'z', 19) == 119 && m.size() == 27);
+}
+
+int
+main(int argc, char* argv[])
+{
+    test_diff<O3::collection::otriemap<char, std::string, std::string>>();
+    test_diff<O3::collection::basic_otriemap<O3::collection::hashed_policy, char, std::string, std::string>>();
+    test_diff<O3::collection::basic_octriemap<O3::collection::hashed_policy, char, std::string, std::string>>();
+    test_diff_skips_identical_subtrees();
+
+    for (size_t threads : { 1, 4 }) {
+        test_merge<O3::collection::otriemap<char, std::string, std::string>>(threads);
+        test_merge<O3::collection::utriemap<char, std::string, std::string>>(threads);
+        test_merge<O3::collection::octriemap<char, std::string, std::string>>(threads);
+        test_merge<O3::collection::uctriemap<char, std::string, std::string>>(threads);
+        test_merge<O3::collection::basic_otriemap<O3::collection::hashed_policy, char, std::string, std::string>>(
+            threads);
+    }
+    test_merge_splices<O3::collection::otriemap<char, std::string, std::string>>();
+    test_merge_splices<O3::collection::utriemap<char, std::string, std::string>>();
+
+    test_fold<O3::collection::otriemap<int, std::string, std::string>>();
+    test_fold<O3::collection::utriemap<int, std::string, std::string>>();
+    test_fold<O3::collection::uctriemap<int, std::string, std::string>>();
+    test_fold<O3::collection::basic_otriemap<O3::collection::aggregate_policy<O3::collection::sum_monoid<int>>,
+                                             int,
+                                             std::string,
+                                             std::string>>();
+    test_fold_strings();
+    test_fold_flags();
+
+    test_pivot<O3::collection::otriemap<int, std::string, char, int>>();
+    test_pivot<O3::collection::utriemap<int, std::string, char, int>>();
+    test_pivot<O3::collection::octriemap<int, std::string, char, int>>();
+    test_pivot<O3::collection::uctriemap<int, std::string, char, int>>();
+    test_pivot<O3::collection::basic_utriemap<O3::collection::aggregate_policy<O3::collection::sum_monoid<int>>,
+                                              int,
+                                              std::string,
+                                              char,
+                                              int>>();
+
+    // Fan-out hints follow their levels
+    using hinted = O3::collection::basic_utriemap<O3::collection::fanout_policy<4, 3, 20>, int, std::string, char, int>;
+    static_assert(std::is_same_v<decltype(O3::algo::pivot<2, 0, 1>(std::declval<const hinted&>())),
+                                 O3::collection::basic_utriemap<O3::collection::fanout_policy<20, 4, 3>,
+                                                                int,
+                                                                int,
+                                                                std::string,
+                                                                char>>);
+    test_pivot<hinted>();
+
+    std::cout << "All algorithm tests passed." << std::endl;
+
+    return 0;
+}
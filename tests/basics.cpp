@@ -1,8 +1,15 @@
 #include <iostream>
+#include <vector>
+#include <map>
+#include <string>
+#include <algorithm>
 #include <limits>
 #include <cassert>
 
 #include "triemap/triemap.h"
+#include "triemap/indexed.h"
+#include "triemap/product.h"
+#include "triemap/expiring.h"
 
 //-------------------------------------------------------------------------------------------------
 // Collections of char data elements addressed by string prefixes.
@@ -10,6 +17,134 @@
 using orepo = O3::collection::otriemap<char, std::string, std::string>;
 using urepo = O3::collection::utriemap<char, std::string, std::string>;
 
+//-------------------------------------------------------------------------------------------------
+// Path-compressed collections of char data elements addressed by string prefixes.
+//-------------------------------------------------------------------------------------------------
+using ocrepo = O3::collection::octriemap<char, std::string, std::string>;
+using ucrepo = O3::collection::uctriemap<char, std::string, std::string>;
+
+// Nodes with keys that copy without throwing move without throwing, so containers of them move on reallocation
+static_assert(std::is_nothrow_move_constructible_v<O3::collection::octriemap<char, int, int>>);
+static_assert(std::is_nothrow_move_constructible_v<O3::collection::uctriemap<char, int, int>>);
+static_assert(std::is_nothrow_move_assignable_v<O3::collection::uctriemap<char, int, int>>);
+
+//-------------------------------------------------------------------------------------------------
+// Collections of char data elements stored out of line.
+//-------------------------------------------------------------------------------------------------
+using obrepo = O3::collection::basic_otriemap<O3::collection::boxed_policy, char, std::string, std::string>;
+using ubrepo = O3::collection::basic_utriemap<O3::collection::boxed_policy, char, std::string, std::string>;
+
+//-------------------------------------------------------------------------------------------------
+// Collections of char data elements with cached subtree hashes.
+//-------------------------------------------------------------------------------------------------
+using ohrepo = O3::collection::basic_otriemap<O3::collection::hashed_policy, char, std::string, std::string>;
+using uhrepo = O3::collection::basic_utriemap<O3::collection::hashed_policy, char, std::string, std::string>;
+using uchrepo = O3::collection::basic_uctriemap<O3::collection::hashed_policy, char, std::string, std::string>;
+
+//-------------------------------------------------------------------------------------------------
+// Collections of char data elements keeping an aggregate of every subtree, with and without a
+// monoid that can remove a part from an aggregate.
+//-------------------------------------------------------------------------------------------------
+using oarepo = O3::collection::
+    basic_otriemap<O3::collection::aggregate_policy<O3::collection::sum_monoid<int>>, char, std::string, std::string>;
+using uarepo = O3::collection::
+    basic_utriemap<O3::collection::aggregate_policy<O3::collection::sum_monoid<int>>, char, std::string, std::string>;
+using ucarepo = O3::collection::
+    basic_uctriemap<O3::collection::aggregate_policy<O3::collection::count_monoid>, char, std::string, std::string>;
+using omrepo = O3::collection::
+    basic_otriemap<O3::collection::aggregate_policy<O3::collection::max_monoid<char>>, char, std::string, std::string>;
+
+//-------------------------------------------------------------------------------------------------
+// Collections of char data elements with aggregates recomputed on demand.
+//-------------------------------------------------------------------------------------------------
+using olrepo = O3::collection::
+    basic_otriemap<O3::collection::lazy_aggregate_policy<O3::collection::sum_monoid<int>>, char, std::string, std::string>;
+using uclrepo = O3::collection::
+    basic_uctriemap<O3::collection::lazy_aggregate_policy<O3::collection::max_monoid<char>>, char, std::string, std::string>;
+
+//-------------------------------------------------------------------------------------------------
+// Collections of char data elements with children ranked by their data or their subtree sums.
+//-------------------------------------------------------------------------------------------------
+struct by_data
+{
+    template<typename N>
+    int operator()(const N& n) const
+    {
+        return n ? *n : 0;
+    }
+};
+
+struct by_total
+{
+    template<typename N>
+    int operator()(const N& n) const
+    {
+        return *n.aggregate();
+    }
+};
+
+using orrepo = O3::collection::basic_otriemap<O3::collection::ranked_policy<by_data>, char, std::string, std::string>;
+using urrepo = O3::collection::basic_utriemap<
+    O3::collection::ranked_policy<by_total, O3::collection::aggregate_policy<O3::collection::sum_monoid<int>>>,
+    char,
+    std::string,
+    std::string>;
+using ucrrepo = O3::collection::basic_uctriemap<
+    O3::collection::ranked_policy<by_total, O3::collection::lazy_aggregate_policy<O3::collection::sum_monoid<int>>>,
+    char,
+    std::string,
+    std::string>;
+
+//-------------------------------------------------------------------------------------------------
+// Collections of char data elements keeping past versions, stamped by a clock set by the tests.
+//-------------------------------------------------------------------------------------------------
+struct test_clock
+{
+    static inline int now = 0;
+
+    int operator()() const
+    {
+        return now;
+    }
+};
+
+using ovrepo = O3::collection::
+    basic_otriemap<O3::collection::versioned_policy<test_clock>, char, std::string, std::string>;
+using uvrepo = O3::collection::
+    basic_utriemap<O3::collection::versioned_policy<test_clock>, char, std::string, std::string>;
+using ucvrepo = O3::collection::
+    basic_uctriemap<O3::collection::versioned_policy<test_clock>, char, std::string, std::string>;
+
+//-------------------------------------------------------------------------------------------------
+// Collections of char data elements with containers sized for an expected fan-out per level.
+//-------------------------------------------------------------------------------------------------
+using ofrepo = O3::collection::basic_otriemap<O3::collection::fanout_policy<1000, 100>, char, std::string, std::string>;
+using ufrepo = O3::collection::basic_utriemap<O3::collection::fanout_policy<1000, 100>, char, std::string, std::string>;
+using ucfrepo =
+    O3::collection::basic_uctriemap<O3::collection::fanout_policy<0, 100>, char, std::string, std::string>;
+
+//-------------------------------------------------------------------------------------------------
+// Collections of char data elements addressed by a pair of string paths.
+//-------------------------------------------------------------------------------------------------
+using strings = std::tuple<std::string, std::string>;
+using oprepo = O3::collection::oproduct<char, strings, strings>;
+using uprepo = O3::collection::uproduct<char, strings, strings>;
+using ucprepo = O3::collection::product<O3::collection::ucmap, O3::collection::policy, char, strings, strings>;
+
+//-------------------------------------------------------------------------------------------------
+// Collections of char data elements addressed by three string prefixes, some of them expiring.
+//-------------------------------------------------------------------------------------------------
+using oerepo = O3::collection::otriemap<char, std::string, std::string, std::string>;
+using uerepo = O3::collection::utriemap<char, std::string, std::string, std::string>;
+
+// Interior nodes of boxed collections hold a pointer instead of the data
+struct large
+{
+    char payload[200];
+};
+static_assert(sizeof(O3::collection::basic_otriemap<O3::collection::boxed_policy, large, std::string>) ==
+              sizeof(void*) + sizeof(O3::collection::omap<std::string, void*>));
+
 //-------------------------------------------------------------------------------------------------
 // Test insertion
 //-------------------------------------------------------------------------------------------------
@@ -135,16 +270,851 @@ test_lookup()
     assert(*r.match("b", "x") == 'B');
 }
 
+//-------------------------------------------------------------------------------------------------
+// Test expansion of inline single-child chains
+//-------------------------------------------------------------------------------------------------
+template<typename REPO>
+void
+test_compression()
+{
+    REPO r;
+
+    // A single chain of nodes stays inline
+    r.insert('C', "a", "c");
+    assert(!r.empty() && r.size() == 1 && r.count() == 3 && r.height() == 2);
+    assert(*r.find("a", "c") == 'C' && r.find("a") == nullptr && r.find("b", "c") == nullptr);
+
+    // Sibling insertion expands the chain
+    r.insert('D', "a", "d");
+    r.insert('B', "b");
+    assert(!r.empty() && r.size() == 3 && r.count() == 5 && r.height() == 2);
+    assert(*r.find("a", "c") == 'C' && *r.find("a", "d") == 'D' && *r.find("b") == 'B');
+    assert(r.match("a", "x") == nullptr && *r.match("b", "x") == 'B');
+
+    // Copies compare equal regardless of which children are inline
+    REPO c = r;
+    assert(c == r && !(c < r) && !(r < c));
+
+    // Erasing down to a single chain moves it back inline
+    assert(r.erase("a", "c") == 1 && r.erase("b") == 1);
+    assert(r.size() == 1 && r.count() == 3 && *r.find("a", "d") == 'D');
+    assert(r.stats().repo_bytes == 0 && r == REPO(r));
+
+    r.insert('E', "e", "e");
+    r.insert('F', "e", "f");
+    auto h = r.extract("e", "f");
+    assert(r.stats().repo_bytes > 0 && r.erase("e", "e") == 1 && r.stats().repo_bytes == 0);
+    assert(r.insert(std::move(h), "a", "f").second && r.size() == 2 && *r.find("a", "f") == 'F');
+    assert(r.erase("a", "d") == 1 && r.stats().repo_bytes == 0 && *r.find("a", "f") == 'F');
+
+    r.clear();
+    assert(r.empty() && r.size() == 0 && r.count() == 1 && r.height() == 0);
+}
+
+//-------------------------------------------------------------------------------------------------
+// Test statistics
+//-------------------------------------------------------------------------------------------------
+template<typename REPO>
+void
+test_statistics()
+{
+    REPO r;
+
+    auto s = r.stats();
+    assert(s.levels.size() == 1 && s.nodes() == 1 && s.data() == 0 && s.levels[0].fanout.at(0) == 1);
+    assert(s.root_bytes == sizeof(REPO) && s.repo_bytes == 0 && s.data_bytes == 0);
+
+    r.insert('0');
+    r.insert('C', "a", "c");
+    r.insert('D', "a", "d");
+    r.insert('B', "b");
+
+    s = r.stats();
+    assert(s.nodes() == r.count() && s.data() == r.size() && s.levels.size() == r.height() + 1);
+    assert(s.levels[0].nodes == 1 && s.levels[0].data == 1 && s.levels[0].fanout.at(2) == 1);
+    assert(s.levels[1].nodes == 2 && s.levels[1].data == 1);
+    assert(s.levels[1].fanout.at(0) == 1 && s.levels[1].fanout.at(2) == 1);
+    assert(s.levels[2].nodes == 2 && s.levels[2].data == 2 && s.levels[2].fanout.at(0) == 2);
+    assert(s.repo_bytes > 0 && s.allocations > 0 && s.bytes() > s.root_bytes);
+}
+
+//-------------------------------------------------------------------------------------------------
+// Test lookup instrumentation
+//-------------------------------------------------------------------------------------------------
+struct counted_policy : O3::collection::policy
+{
+    using probe = O3::collection::counting_probe<counted_policy>;
+};
+
+void
+test_instrumentation()
+{
+    using probe = counted_policy::probe;
+    O3::collection::basic_otriemap<counted_policy, char, std::string, std::string> r;
+
+    r.insert('A', "a");
+    r.insert('C', "a", "c");
+    probe::reset();
+
+    assert(*r.find("a", "c") == 'C');
+    assert(r.find("a", "x") == nullptr);
+    assert(*r.match("a", "x") == 'A');
+    assert(r.match("x", "x") == nullptr);
+    r.climb_pre([](const auto&...) { return true; }, "a", "c");
+
+    auto ps = probe::snapshot();
+    assert(ps.finds == 2 && ps.find_misses == 1);
+    assert(ps.matches == 2 && ps.match_misses == 1 && ps.match_depth[1] == 1);
+    assert(ps.lookups() == 4 && ps.misses() == 2);
+    assert(ps.climbs == 1 && ps.climb_nodes == 3 && ps.climb_length[3] == 1);
+    assert(ps.probes[0] == 5 && ps.probes[1] == 4);
+
+    probe::reset();
+    assert(probe::snapshot().lookups() == 0);
+}
+
+//-------------------------------------------------------------------------------------------------
+// Test capacity hints and reserve along a key path
+//-------------------------------------------------------------------------------------------------
+template<typename REPO>
+void
+test_reserve(size_t root, size_t child, size_t reserved)
+{
+    // Hinted containers are allocated with the node, so they show up before any data
+    REPO r;
+    assert(r.stats().repo_bytes >= root * sizeof(void*));
+    r.insert('A', "a", "x");
+    assert(r.stats().repo_bytes >= (root + child) * sizeof(void*));
+
+    // Reserve creates the nodes on the path and leaves the data alone
+    r.reserve(500, "b");
+    assert(r.size() == 1 && r.count() == 4 && r.find("b") == nullptr);
+    assert(r.stats().repo_bytes >= (root + std::max(child, reserved)) * sizeof(void*));
+    r.reserve(10);
+    r.insert('B', "b", "y");
+    assert(*r.find("a", "x") == 'A' && *r.find("b", "y") == 'B' && r.size() == 2 && r.count() == 5);
+
+    REPO c = r;
+    assert(c == r);
+    assert(r.erase("b", "y") == 1 && r.count() == 3);
+}
+
+//-------------------------------------------------------------------------------------------------
+// Test compaction after erasures
+//-------------------------------------------------------------------------------------------------
+template<typename REPO>
+void
+test_compaction(bool shrinks)
+{
+    REPO r;
+    for (int i = 0; i < 1000; ++i) {
+        r.insert(char('a' + i % 26), std::to_string(i % 10), std::to_string(i));
+    }
+    for (int i = 0; i < 1000; ++i) {
+        if (i % 100 != 0) {
+            r.erase(std::to_string(i % 10), std::to_string(i));
+        }
+    }
+    assert(r.size() == 10 && r.count() == 12);
+
+    // Incremental pass over the same content, the root first and then one subtree at a time
+    REPO c = r;
+    REPO e = r;
+    assert(c.shrink_to_fit() == 1 && c.compact("0") == 10);
+    assert(c.compact("1") == 0 && c.shrink_to_fit("1") == 0 && c.compact("0", "0") == 0);
+
+    auto before = r.stats();
+    assert(r.compact() == r.count() - 1);
+    assert(r == e && r.size() == 10 && *r.find("0", "900") == 'q' && r.find("1", "1") == nullptr);
+    auto after = r.stats();
+    assert(after.allocations <= before.allocations);
+    assert(shrinks ? after.repo_bytes < before.repo_bytes : after.repo_bytes == before.repo_bytes);
+    assert(c == r && c.stats().repo_bytes == after.repo_bytes);
+
+    // Compacted trie-map is modified as usual
+    r.insert('Z', "0", "1");
+    r.erase("0", "0");
+    assert(r.size() == 10 && *r.find("0", "1") == 'Z' && r.compact() == r.count() - 1);
+}
+
+//-------------------------------------------------------------------------------------------------
+// Test subtree hashes
+//-------------------------------------------------------------------------------------------------
+template<typename REPO>
+void
+test_digest()
+{
+    REPO l, r;
+    assert(l.digest() == r.digest());
+
+    l.insert('0');
+    l.insert('C', "a", "c");
+    l.insert('D', "a", "d");
+    l.insert('B', "b");
+    assert(l.digest() != r.digest() && !(l == r));
+
+    // Same content inserted in different order
+    r.insert('B', "b");
+    r.insert('D', "a", "d");
+    r.insert('C', "a", "c");
+    assert(l.digest() != r.digest());
+    r.insert('0');
+    assert(l.digest() == r.digest() && l == r);
+
+    // Same content in the other flavour
+    ohrepo o;
+    o.insert('0');
+    o.insert('B', "b");
+    o.insert('C', "a", "c");
+    o.insert('D', "a", "d");
+    assert(o.digest() == l.digest());
+
+    // Data is only modified through the trie-map, so a pointer kept across a digest cannot make it stale
+    static_assert(std::is_same_v<decltype(l.find("a", "c")), const char*>);
+    static_assert(std::is_same_v<decltype(l.insert('C', "a", "c").first), const char*>);
+    auto before = l.digest();
+    l.update([](char& d) { d = 'X'; }, "a", "c");
+    assert(l.digest() != before && l.digest() != r.digest() && !(l == r));
+    l.update([](char& d) { d = 'C'; }, "a", "c");
+    assert(l.digest() == before && l == r);
+
+    // Modifications of nodes reached through non-const access invalidate the path
+    l.jump([](auto& n) { n.update([](char& d) { d = 'Y'; }); }, "a", "d");
+    assert(l.digest() != before);
+    l.jump([](auto& n) { n.update([](char& d) { d = 'D'; }); }, "a", "d");
+    assert(l.digest() == before);
+
+    l.erase("a", "c");
+    assert(l.digest() != before);
+    l.insert('C', "a", "c");
+    assert(l.digest() == before);
+
+    l.traverse_post([](auto& n, auto&&...) {
+        n.update([](char& d) { d = d == 'B' ? 'Z' : d; });
+        return true;
+    });
+    assert(l.digest() != before);
+
+    // Compaction moves nodes and keeps the hashes
+    before = l.digest();
+    l.compact();
+    assert(l.digest() == before);
+
+    // Copies keep the hashes
+    REPO c = l;
+    assert(c.digest() == l.digest() && c == l);
+    c.clear();
+    assert(c.digest() == REPO().digest());
+}
+
+//-------------------------------------------------------------------------------------------------
+// Test moving subtrees with node handles
+//-------------------------------------------------------------------------------------------------
+template<typename REPO>
+void
+test_extraction(bool stable)
+{
+    REPO r;
+    r.insert('0');
+    r.insert('A', "a");
+    r.insert('C', "a", "c");
+    r.insert('D', "b", "d");
+    r.insert('E', "b", "e");
+    const char* c = r.find("a", "c");
+
+    assert(r.extract("x").empty() && r.extract("a", "x").empty() && r.extract("x", "c").empty());
+    assert(r.size() == 5);
+
+    // Move a leaf under another parent and a new key
+    auto h = r.extract("a", "c");
+    assert(!h.empty() && *h.mapped() == 'C' && r.find("a", "c") == nullptr && r.size() == 4);
+    auto rv = r.insert(std::move(h), "b", "f");
+    assert(rv.second && h.empty() && **rv.first == 'C' && *r.find("b", "f") == 'C');
+    assert(!stable || r.find("b", "f") == c);
+
+    // Grafting over an existing key leaves the handle with the caller
+    h = r.extract("b", "f");
+    rv = r.insert(std::move(h), "b", "d");
+    assert(!rv.second && **rv.first == 'D' && !h.empty() && *h.mapped() == 'C');
+
+    // Parents left empty are removed, new parents are created
+    rv = r.insert(std::move(h), "z", "c");
+    assert(rv.second && *r.find("z", "c") == 'C');
+
+    // Empty handles are not grafted and leave no parents behind
+    REPO s = r;
+    rv     = r.insert(std::move(h), "w", "c");
+    assert(!rv.second && rv.first == nullptr && r.count() == 7 && r == s);
+    auto d = r.extract("b", "d");
+    auto e = r.extract("b", "e");
+    assert(r.find("b") == nullptr && r.count() == 4 && r.size() == 3);
+
+    // Whole subtrees move with their children
+    auto z = r.extract("z");
+    assert(*z.mapped().find("c") == 'C');
+    r.insert(std::move(z), "y");
+    r.insert(std::move(d), "y", "d");
+    r.insert(std::move(e), "a", "e");
+    assert(*r.find("y", "c") == 'C' && *r.find("y", "d") == 'D' && *r.find("a", "e") == 'E' && r.size() == 5);
+    assert(!stable || r.find("y", "c") == c);
+}
+
+//-------------------------------------------------------------------------------------------------
+// Test subtree aggregates
+//-------------------------------------------------------------------------------------------------
+// Aggregate of the given data elements
+template<typename REPO>
+typename REPO::aggregate_type
+folded(const std::string& data)
+{
+    using monoid = typename REPO::monoid_type;
+
+    auto rv = monoid::identity();
+    for (char c : data) {
+        rv = monoid::combine(rv, monoid::lift(c));
+    }
+    return rv;
+}
+
+template<typename REPO>
+void
+test_aggregate()
+{
+    REPO r;
+    assert(*r.aggregate() == folded<REPO>("") && r.aggregate("a") == nullptr);
+
+    r.insert('0');
+    r.insert('C', "a", "c");
+    r.insert('D', "a", "d");
+    r.insert('B', "b");
+    r.insert('E', "b", "e");
+    assert(*r.aggregate() == folded<REPO>("0CDBE") && *r.aggregate("a") == folded<REPO>("CD"));
+    assert(*r.aggregate("a", "c") == folded<REPO>("C") && *r.aggregate("b") == folded<REPO>("BE"));
+    assert(r.insert('X', "a", "c").second == false && *r.aggregate() == folded<REPO>("0CDBE"));
+
+    // Updates through the trie-map
+    assert(r.update([](char& c) { c = 'Z'; }, "a", "c") && *r.find("a", "c") == 'Z');
+    assert(*r.aggregate("a") == folded<REPO>("ZD") && *r.aggregate("a", "c") == folded<REPO>("Z"));
+    assert(r.update([](char& c) { c = 'A'; }, "b", "e") && *r.aggregate("b") == folded<REPO>("BA"));
+    assert(!r.update([](char& c) { c = 'Q'; }, "a") && !r.update([](char& c) { c = 'Q'; }, "x", "y"));
+    assert(r.update([](char& c) { c = '1'; }) && *r.aggregate() == folded<REPO>("1ZDBA"));
+
+    // Erasing the last data below a parent removes it together with its aggregate
+    r.erase("b", "e");
+    r.erase("b");
+    assert(r.aggregate("b") == nullptr && *r.aggregate() == folded<REPO>("1ZD"));
+    assert(r.erase("x", "y") == 0 && *r.aggregate() == folded<REPO>("1ZD"));
+
+    // Data is only modified through the trie-map, so a pointer kept across a read cannot make it stale
+    static_assert(std::is_same_v<decltype(r.find("a", "d")), const char*>);
+    static_assert(std::is_same_v<decltype(r.insert('D', "a", "d").first), const char*>);
+
+    // Modifications of nodes reached through non-const access leave the path stale until the next read
+    r.jump([](auto& n) { n.update([](char& d) { d = 'Q'; }); }, "a", "d");
+    assert(*r.aggregate("a") == folded<REPO>("ZQ") && *r.aggregate("a", "d") == folded<REPO>("Q"));
+    r.child("a").update([](char& d) { d = 'R'; }, "d");
+    r.insert('F', "a", "f");
+    assert(*r.aggregate("a") == folded<REPO>("ZRF") && *r.aggregate() == folded<REPO>("1ZRF"));
+    r.traverse_post([](auto& n, auto&&...) {
+        n.update([](char& d) { d = d == 'F' ? 'G' : d; });
+        return true;
+    });
+    assert(*r.aggregate("a", "f") == folded<REPO>("G") && *r.aggregate() == folded<REPO>("1ZRG"));
+
+    // Moved subtrees carry their aggregates
+    auto h = r.extract("a", "c");
+    assert(*r.aggregate("a") == folded<REPO>("RG") && *r.aggregate() == folded<REPO>("1RG"));
+    r.insert(std::move(h), "x", "c");
+    assert(*r.aggregate("x") == folded<REPO>("Z") && *r.aggregate() == folded<REPO>("1RGZ"));
+
+    REPO o;
+    o.insert('H', "a", "h");
+    o.insert('Y', "y");
+    r.merge(std::move(o), [](char& d, char&& s) { d = s; });
+    assert(*r.aggregate("a") == folded<REPO>("RGH") && *r.aggregate("y") == folded<REPO>("Y"));
+    assert(*r.aggregate() == folded<REPO>("1RGHZY") && *o.aggregate() == folded<REPO>(""));
+
+    // Bursts of updates are rolled up by refresh or by the next read
+    for (char c = 'a'; c <= 'z'; ++c) {
+        r.insert(c, "a", std::string(1, c));
+        r.update([](char& d) { d = d == 'z' ? 'a' : d + 1; }, "a", "c");
+    }
+    r.refresh();
+    assert(*r.aggregate("a") == folded<REPO>("abaReGgHijklmnopqrstuvwxyz"));
+    assert(*r.aggregate("a", "c") == folded<REPO>("a"));
+    r.erase("a", "q");
+    r.update([](char& d) { d = '!'; }, "a", "z");
+    assert(*r.aggregate("a") == folded<REPO>("abaReGgHijklmnoprstuvwxy!"));
+    assert(*r.aggregate() == folded<REPO>("1abaReGgHijklmnoprstuvwxy!ZY"));
+
+    r.compact();
+    assert(*r.aggregate() == folded<REPO>("1abaReGgHijklmnoprstuvwxy!ZY") && *r.aggregate("x") == folded<REPO>("Z"));
+
+    REPO c = r;
+    assert(*c.aggregate() == *r.aggregate());
+    r.clear();
+    assert(*r.aggregate() == folded<REPO>(""));
+}
+
+//-------------------------------------------------------------------------------------------------
+// Test ranking of children
+//-------------------------------------------------------------------------------------------------
+
+// Keys of the top k children of the node given the list of prefixes, best first
+template<typename REPO, typename... PS>
+std::string
+top(const REPO& r, size_t k, PS&&... ps)
+{
+    std::string result;
+    r.top_k(
+        [&](const auto&, const std::string& p) {
+            result += p;
+            return true;
+        },
+        k,
+        ps...);
+    return result;
+}
+
+// Children are ranked by their own data, or by the totals of their subtrees
+template<typename REPO>
+void
+test_ranking(bool totals)
+{
+    REPO r;
+    assert(top(r, 10).empty() && top(r, 10, "a").empty());
+
+    // New children scoring as much as an empty node are ranked too
+    r.insert('\0', "z", "z");
+    assert(top(r, 10) == "z" && top(r, 10, "z") == "z");
+    r.erase("z", "z");
+    assert(top(r, 10).empty() && r.leaf());
+
+    r.insert('5', "a");
+    r.insert('3', "a", "a");
+    r.insert('9', "a", "b");
+    r.insert('1', "a", "c");
+    r.insert('7', "b");
+    r.insert('2', "b", "a");
+    r.insert('4', "c");
+    r.insert('4', "d");
+    assert(top(r, 10) == (totals ? "abcd" : "bacd") && top(r, 10, "a") == "bac" && top(r, 10, "b") == "a");
+    assert(top(r, 0).empty() && top(r, 1) == (totals ? "a" : "b") && top(r, 2, "a") == "ba" && top(r, 10, "x").empty());
+
+    // Stop early
+    size_t visited = 0;
+    r.top_k([&](const auto&, const auto&) { return ++visited < 2; }, 3);
+    assert(visited == 2);
+
+    // Modifications through the trie-map move the entries
+    r.update([](char& c) { c = '0'; }, "a", "b");
+    assert(top(r, 10) == (totals ? "abcd" : "bacd") && top(r, 10, "a") == "acb");
+    r.update([](char& c) { c = '9'; }, "c");
+    assert(top(r, 10) == (totals ? "abcd" : "cbad"));
+    r.erase("b", "a");
+    r.erase("d");
+    assert(top(r, 10) == (totals ? "acb" : "cba") && top(r, 10, "b").empty());
+    auto h = r.extract("a", "a");
+    assert(top(r, 10) == (totals ? "acb" : "cba") && top(r, 10, "a") == "cb");
+    r.insert(std::move(h), "b", "z");
+    assert(top(r, 10) == (totals ? "abc" : "cba") && top(r, 10, "b") == "z");
+
+    // Data is only modified through the trie-map, and any other non-const access rebuilds the ranking on the next read
+    static_assert(std::is_same_v<decltype(r.find("a", "c")), const char*>);
+    r.jump([](auto& n) { n.update([](char& d) { d = '8'; }); }, "a", "c");
+    assert(top(r, 10, "a") == "cb");
+    r.child("x").insert('6', "y");
+    assert(top(r, 10) == (totals ? "abcx" : "cbax") && top(r, 10, "x") == "y");
+
+    REPO o;
+    o.insert('9', "b", "q");
+    o.insert('1', "e");
+    r.merge(std::move(o), [](char& d, char&& s) { d = s; });
+    assert(top(r, 10) == (totals ? "bacxe" : "cbaex") && top(r, 10, "b") == "qz");
+
+    r.compact();
+    assert(top(r, 10) == (totals ? "bacxe" : "cbaex") && top(r, 3, "b") == "qz");
+
+    REPO c = r;
+    assert(top(c, 10) == top(r, 10) && top(c, 10, "a") == "cb");
+    r.clear();
+    assert(top(r, 10).empty());
+}
+
+//-------------------------------------------------------------------------------------------------
+// Test lookups as of past time stamps and trimming of old versions
+//-------------------------------------------------------------------------------------------------
+template<typename REPO>
+void
+test_versions()
+{
+    auto set = [](char c) { return [c](char& d) { d = c; }; };
+
+    REPO r;
+    test_clock::now = 10;
+    r.insert('0');
+    r.insert('A', "u1", "limit");
+    test_clock::now = 20;
+    r.update(set('B'), "u1", "limit");
+    r.insert('C', "u1");
+    test_clock::now = 30;
+    assert(r.erase("u1", "limit") == 1);
+
+    // Erased data leaves its node in place until its versions are trimmed
+    assert(r.find("u1", "limit") == nullptr && r.size() == 2 && r.count() == 3);
+    assert(r.find_as_of(5, "u1", "limit") == nullptr && *r.find_as_of(10, "u1", "limit") == 'A');
+    assert(*r.find_as_of(15, "u1", "limit") == 'A' && *r.find_as_of(25, "u1", "limit") == 'B');
+    assert(r.find_as_of(30, "u1", "limit") == nullptr && r.find_as_of(30, "u2") == nullptr);
+    assert(*r.match_as_of(15, "u1", "limit") == 'A' && *r.match_as_of(35, "u1", "limit") == 'C');
+    assert(*r.match_as_of(15, "u1", "other") == '0' && r.match_as_of(5, "u1", "limit") == nullptr);
+
+    // Modifications within one stamp replace the last version, writes through a pointer change it in place
+    test_clock::now = 40;
+    r.update(set('D'), "u1");
+    r.update(set('E'), "u1");
+    assert(*r.find_as_of(40, "u1") == 'E' && *r.find_as_of(39, "u1") == 'C');
+    *r.find("u1") = 'F';
+    assert(*r.find_as_of(40, "u1") == 'F' && *r.find_as_of(39, "u1") == 'C');
+
+    REPO c = r;
+    assert(c == r && *c.find_as_of(25, "u1", "limit") == 'B');
+
+    // Versions visible at the watermark stay, earlier ones and trailing erasures go
+    assert(r.trim(20) == 1 && r.count() == 3);
+    assert(*r.find_as_of(20, "u1", "limit") == 'B' && *r.find_as_of(20, "u1") == 'C');
+    assert(r.trim(30) == 2 && r.count() == 2);
+    assert(r.trim(100) == 1 && r.trim(100) == 0 && *r.find("u1") == 'F' && *r.find_as_of(100) == '0');
+
+    test_clock::now = 50;
+    assert(r.erase("u1") == 1 && r.count() == 2);
+    assert(r.trim(60) == 2 && r.count() == 1 && r.size() == 1 && !r.empty());
+    assert(!(c == r));
+
+    // Clearing erases the data of every node and keeps the nodes with their past versions
+    test_clock::now = 70;
+    c.clear();
+    assert(c.size() == 0 && c.count() == 3 && c.find_as_of(70) == nullptr && c.find_as_of(70, "u1") == nullptr);
+    assert(*c.find_as_of(15) == '0' && *c.find_as_of(15, "u1", "limit") == 'A' && *c.find_as_of(40, "u1") == 'F');
+    assert(c.trim(100) == 8 && c.count() == 1 && c.empty());
+}
+
+//-------------------------------------------------------------------------------------------------
+// Test expiry of data by a timer wheel
+//-------------------------------------------------------------------------------------------------
+template<typename REPO>
+void
+test_expiry()
+{
+    O3::collection::expiring<REPO> r(100);
+    r.insert('0', "ff");
+    assert(r.insert_for(10, 'A', "ff", "svc").second);
+    assert(r.insert_for(5, 'B', "ff", "svc", "sup").second);
+    assert(r.insert_for(5000, 'C', "ff", "ops", "dev").second);
+    assert(r.insert_for(0, 'D', "x").second);
+    assert(!r.insert_for(1, 'X', "ff").second && r.deadline("ff") == 0 && r.deadline("ff", "svc") == 110);
+    assert(r.size() == 5 && r.pending() == 4 && r.trie().count() == 7);
+
+    // Due data is erased together with the parents it leaves empty
+    assert(r.advance(100) == 0 && r.now() == 100);
+    assert(r.advance(101) == 1 && r.find("x") == nullptr && r.trie().count() == 6);
+    assert(r.advance(107) == 1 && *r.match("ff", "svc", "sup") == 'A' && r.trie().count() == 5);
+
+    // Expiry can be moved, cancelled and is cancelled by erase
+    assert(r.expire(1000, "ff", "svc") && r.deadline("ff", "svc") == 1107);
+    assert(!r.expire(1, "nothing") && !r.persist("ff"));
+    assert(r.advance(200) == 0 && r.size() == 3);
+    assert(r.erase("ff", "ops", "dev") == 1 && r.pending() == 1 && r.trie().count() == 3);
+
+    // Deadlines far ahead go to the upper levels of the wheel
+    const uint64_t far = uint64_t(1) << 40;
+    assert(r.insert_for(far, 'C', "ff", "ops", "dev").second && r.deadline("ff", "ops", "dev") == 200 + far);
+    assert(r.advance(1106) == 0 && r.advance(1107) == 1 && r.find("ff", "svc") == nullptr);
+    assert(r.advance(199 + far) == 0 && r.trie().count() == 4);
+    assert(r.advance(200 + far) == 1 && r.trie().count() == 2 && r.size() == 1 && r.pending() == 0);
+
+    // Random deadlines expire exactly when due
+    std::map<std::string, uint64_t> due;
+    uint64_t                        seed = 7;
+    auto                            next = [&](uint64_t n) {
+        seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+        return (seed >> 33) % n;
+    };
+    for (int i = 0; i < 500; ++i) {
+        auto key = std::to_string(next(200));
+        auto ttl = next(2) ? next(100) : next(100000);
+        if (r.insert_for(ttl, 'R', "rnd", key).second) {
+            due[key] = r.now() + std::max<uint64_t>(ttl, 1);
+        }
+        if (i % 10 == 0) {
+            auto   until   = r.now() + next(3000);
+            size_t expired = 0;
+            for (auto itr = due.begin(); itr != due.end();) {
+                expired += itr->second <= until ? 1 : 0;
+                itr = itr->second <= until ? due.erase(itr) : std::next(itr);
+            }
+            assert(r.advance(until) == expired && r.pending() == due.size());
+        }
+    }
+    // Timers survive compaction of the trie-map
+    r.compact("rnd");
+    for (const auto& d : due) {
+        assert(r.deadline("rnd", d.first) == d.second);
+    }
+    assert(r.advance(r.now() + 100000) == due.size() && r.size() == 1 && r.pending() == 0);
+
+    r.clear();
+    assert(r.size() == 0 && r.pending() == 0 && r.advance(r.now() + far) == 0);
+}
+
+//-------------------------------------------------------------------------------------------------
+// Test reverse index from data to key paths
+//-------------------------------------------------------------------------------------------------
+template<typename INDEXED>
+std::string
+holders(const INDEXED& x, const typename INDEXED::value_type& v)
+{
+    std::string result;
+    x.paths(v, [&](const auto&... ps) {
+        ((result += '/', result += ps), ...);
+        result += ';';
+    });
+    return result;
+}
+
+template<typename REPO>
+void
+test_reverse_index()
+{
+    REPO r;
+    r.insert('X');
+    r.insert('X', "a", "c");
+    r.insert('Y', "a");
+    r.insert('X', "b", "d");
+    r.insert('Y', "b", "e");
+
+    // Indexing an existing trie-map
+    O3::collection::indexed<REPO> x(r);
+    assert(x.size() == 5 && x.count('X') == 3 && x.count('Y') == 2 && x.count('Z') == 0);
+    assert(holders(x, 'X') == ";/a/c;/b/d;" && holders(x, 'Y') == "/a;/b/e;" && holders(x, 'Z').empty());
+
+    // Modifications keep the index in step
+    assert(x.insert('Z', "c").second && !x.insert('Q', "c").second && holders(x, 'Z') == "/c;" && x.count('Q') == 0);
+    assert(x.update([](char& c) { c = 'Z'; }, "a", "c") && holders(x, 'Z') == "/c;/a/c;");
+    assert(holders(x, 'X') == ";/b/d;");
+    assert(x.update([](char& c) { c = 'Y'; }, "b", "e") && holders(x, 'Y') == "/a;/b/e;");
+    assert(!x.update([](char& c) { c = 'Y'; }, "x", "y"));
+
+    assert(x.erase() == 1 && x.erase("b", "d") == 1 && x.erase("b", "d") == 0);
+    assert(x.count('X') == 0 && holders(x, 'X').empty() && x.trie().find("b", "d") == nullptr);
+    assert(*x.find("a") == 'Y' && x.size() == 4);
+
+    // Updates may move the data, as versioned data does when its chain of versions grows
+    for (char c : { 'P', 'Q', 'R', 'S', 'T' }) {
+        ++test_clock::now;
+        assert(x.update([c](char& d) { d = c; }, "a") && holders(x, c) == "/a;" && *x.find("a") == c);
+    }
+    assert(holders(x, 'Y') == "/b/e;" && x.count('P') == 0 && x.size() == 4);
+
+    x.clear();
+    assert(x.size() == 0 && x.count('Y') == 0);
+
+    // Projections group different data
+    O3::collection::indexed<REPO, int (*)(int)> lower(r, [](int c) { return c | 0x20; });
+    assert(lower.count('x') == 3 && lower.count('X') == 0);
+}
+
+//-------------------------------------------------------------------------------------------------
+// Test two-dimensional lookups
+//-------------------------------------------------------------------------------------------------
+template<typename REPO>
+void
+test_product()
+{
+    using std::make_tuple;
+
+    REPO r;
+    assert(r.insert('A', make_tuple("eu", "de"), make_tuple("svc")).second);
+    assert(r.insert('B', make_tuple("eu"), make_tuple("svc", "sup")).second);
+    assert(r.insert('C', make_tuple(), make_tuple()).second);
+    assert(r.insert('D', make_tuple("eu", "de"), make_tuple()).second);
+    assert(!r.insert('X', make_tuple("eu"), make_tuple("svc", "sup")).second && r.size() == 4);
+
+    // Short paths do not match longer ones
+    assert(*r.find(make_tuple("eu", "de"), make_tuple("svc")) == 'A');
+    assert(*r.find(make_tuple("eu"), make_tuple("svc", "sup")) == 'B' && *r.find(make_tuple(), make_tuple()) == 'C');
+    assert(r.find(make_tuple("eu"), make_tuple("svc")) == nullptr);
+    assert(r.find(make_tuple("eu", "de"), make_tuple("svc", "sup")) == nullptr);
+
+    // The longest outer path with an inner match wins
+    assert(*r.match(make_tuple("eu", "de"), make_tuple("svc", "sup")) == 'A');
+    assert(*r.match(make_tuple("eu", "de"), make_tuple("ops")) == 'D');
+    assert(*r.match(make_tuple("eu", "fr"), make_tuple("svc", "sup")) == 'B');
+    assert(*r.match(make_tuple("eu", "fr"), make_tuple("svc")) == 'C');
+    assert(*r.match(make_tuple("us"), make_tuple("svc", "sup")) == 'C');
+
+    // Precedence decides between a longer outer and a longer inner path
+    assert(r.insert('F', make_tuple("eu"), make_tuple("svc", "rep")).second);
+    auto both = [&](auto&& precedence) { return *r.match(make_tuple("eu", "de"), make_tuple("svc", "rep"), precedence); };
+    assert(both(O3::collection::outer_first()) == 'A' && both(O3::collection::inner_first()) == 'F');
+    assert(both(O3::collection::most_specific()) == 'A');
+    assert(*r.match(make_tuple("eu", "fr"), make_tuple("svc", "rep"), O3::collection::inner_first()) == 'F');
+    auto inner_only = [](const O3::collection::match_depths& x, const O3::collection::match_depths& y) {
+        return x.inner > y.inner || (x.inner == y.inner && x.outer < y.outer);
+    };
+    assert(both(inner_only) == 'F' && *r.match(make_tuple("eu", "de"), make_tuple("svc"), inner_only) == 'A');
+    assert(*r.match(make_tuple("eu", "de"), make_tuple("ops"), inner_only) == 'C');
+    assert(r.erase(make_tuple("eu"), make_tuple("svc", "rep")) == 1);
+
+    *r.match(make_tuple("eu", "de"), make_tuple("ops")) = 'E';
+    assert(*r.find(make_tuple("eu", "de"), make_tuple()) == 'E');
+
+    REPO c = r;
+    assert(c == r);
+    assert(r.erase(make_tuple(), make_tuple()) == 1 && r.erase(make_tuple(), make_tuple()) == 0);
+    assert(r.match(make_tuple("us"), make_tuple("svc")) == nullptr && !(c == r));
+    assert(r.erase(make_tuple("eu"), make_tuple("svc", "sup")) == 1);
+    assert(r.match(make_tuple("eu", "fr"), make_tuple("svc", "sup")) == nullptr && r.size() == 2);
+
+    r.clear();
+    assert(r.size() == 0 && r.trie().count() == 1);
+}
+
 int
 main(int argc, char* argv[])
 {
     test_insertion<orepo>();
     test_removal<orepo>();
     test_lookup<orepo>();
+    test_statistics<orepo>();
+    test_extraction<orepo>(true);
+    test_compaction<orepo>(false);
 
     test_insertion<urepo>();
     test_removal<urepo>();
     test_lookup<urepo>();
+    test_statistics<urepo>();
+    test_extraction<urepo>(true);
+    test_compaction<urepo>(true);
+
+    test_insertion<ocrepo>();
+    test_removal<ocrepo>();
+    test_lookup<ocrepo>();
+    test_statistics<ocrepo>();
+    test_extraction<ocrepo>(false);
+    test_compression<ocrepo>();
+    test_compaction<ocrepo>(false);
+
+    test_insertion<ucrepo>();
+    test_removal<ucrepo>();
+    test_lookup<ucrepo>();
+    test_statistics<ucrepo>();
+    test_extraction<ucrepo>(false);
+    test_compression<ucrepo>();
+    test_compaction<ucrepo>(true);
+
+    test_insertion<obrepo>();
+    test_removal<obrepo>();
+    test_lookup<obrepo>();
+    test_statistics<obrepo>();
+    test_extraction<obrepo>(true);
+
+    test_insertion<ubrepo>();
+    test_removal<ubrepo>();
+    test_lookup<ubrepo>();
+    test_statistics<ubrepo>();
+    test_compaction<ubrepo>(true);
+
+    test_insertion<ofrepo>();
+    test_removal<ofrepo>();
+    test_reserve<ofrepo>(0, 0, 0);
+    test_compaction<ofrepo>(false);
+
+    test_insertion<ufrepo>();
+    test_removal<ufrepo>();
+    test_lookup<ufrepo>();
+    test_reserve<ufrepo>(1000, 100, 500);
+    test_compaction<ufrepo>(true);
+
+    test_insertion<ucfrepo>();
+    test_reserve<ucfrepo>(0, 100, 500);
+
+    test_insertion<ohrepo>();
+    test_removal<ohrepo>();
+    test_lookup<ohrepo>();
+    test_statistics<ohrepo>();
+    test_digest<ohrepo>();
+
+    test_insertion<uhrepo>();
+    test_removal<uhrepo>();
+    test_lookup<uhrepo>();
+    test_statistics<uhrepo>();
+    test_extraction<uhrepo>(true);
+    test_digest<uhrepo>();
+
+    test_insertion<uchrepo>();
+    test_removal<uchrepo>();
+    test_lookup<uchrepo>();
+    test_digest<uchrepo>();
+
+    test_insertion<oarepo>();
+    test_removal<oarepo>();
+    test_lookup<oarepo>();
+    test_aggregate<oarepo>();
+
+    test_insertion<uarepo>();
+    test_removal<uarepo>();
+    test_lookup<uarepo>();
+    test_aggregate<uarepo>();
+
+    test_insertion<ucarepo>();
+    test_removal<ucarepo>();
+    test_aggregate<ucarepo>();
+
+    test_insertion<omrepo>();
+    test_aggregate<omrepo>();
+
+    test_insertion<olrepo>();
+    test_removal<olrepo>();
+    test_aggregate<olrepo>();
+
+    test_insertion<uclrepo>();
+    test_aggregate<uclrepo>();
+
+    test_insertion<orrepo>();
+    test_removal<orrepo>();
+    test_ranking<orrepo>(false);
+
+    test_insertion<urrepo>();
+    test_ranking<urrepo>(true);
+
+    test_insertion<ucrrepo>();
+    test_ranking<ucrrepo>(true);
+
+    test_insertion<ovrepo>();
+    test_lookup<ovrepo>();
+    test_versions<ovrepo>();
+
+    test_insertion<uvrepo>();
+    test_lookup<uvrepo>();
+    test_versions<uvrepo>();
+
+    test_insertion<ucvrepo>();
+    test_versions<ucvrepo>();
+
+    test_reverse_index<orepo>();
+    test_reverse_index<urepo>();
+    test_reverse_index<ocrepo>();
+    test_reverse_index<ovrepo>();
+    test_reverse_index<uvrepo>();
+
+    test_expiry<oerepo>();
+    test_expiry<uerepo>();
+
+    test_product<oprepo>();
+    test_product<uprepo>();
+    test_product<ucprepo>();
+
+    test_instrumentation();
 
     std::cout << "All basic tests passed." << std::endl;
 
@@ -0,0 +1,361 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <cstdio>
+#include <cassert>
+
+#include "triemap/triemap.h"
+#include "triemap/io/json.h"
+#include "triemap/io/json_reader.h"
+#include "triemap/io/binary.h"
+#include "triemap/io/exporter.h"
+
+//-------------------------------------------------------------------------------------------------
+// Data element that only knows how to print itself to a stream
+//-------------------------------------------------------------------------------------------------
+struct Data
+{
+    char value;
+
+    bool operator==(const Data& oth) const
+    {
+        return value == oth.value;
+    }
+};
+
+std::ostream&
+operator<<(std::ostream& os, const Data& d)
+{
+    os << d.value;
+    return os;
+}
+
+template<>
+struct O3::io::json::traits<Data>
+{
+    template<class CharT, class Traits>
+    static inline void print(std::basic_ostream<CharT, Traits>& os, const Data& t)
+    {
+        os << O3::io::json::quoted(t);
+    }
+    static inline const char* dtag()
+    {
+        return "value";
+    }
+};
+
+template<>
+struct O3::io::json::parse_traits<Data>
+{
+    static inline Data parse(std::string_view text)
+    {
+        return Data{ parse_traits<char>::parse(text) };
+    }
+};
+
+//-------------------------------------------------------------------------------------------------
+// Return stream and writer output of a collection in the given format
+//-------------------------------------------------------------------------------------------------
+template<typename REPO>
+std::string
+streamed(const REPO& r, O3::io::json::kind k)
+{
+    std::ostringstream os;
+    switch (k) {
+        case O3::io::json::kind::like:
+            os << O3::io::json::like(r);
+            break;
+        case O3::io::json::kind::proper:
+            os << O3::io::json::proper(r);
+            break;
+        case O3::io::json::kind::d3:
+            os << O3::io::json::d3(r);
+            break;
+    }
+    return os.str();
+}
+
+template<typename REPO>
+std::string
+written(const REPO& r, O3::io::json::kind k, bool pretty = true)
+{
+    O3::io::json::writer w(pretty);
+    return w.write(r, k).str();
+}
+
+// Remove new lines together with the indentation that follows them
+std::string
+squeeze(const std::string& s)
+{
+    std::string result;
+    for (size_t i = 0; i < s.size(); ++i) {
+        if (s[i] == '\n') {
+            while (i + 1 < s.size() && s[i + 1] == ' ') {
+                ++i;
+            }
+        } else {
+            result += s[i];
+        }
+    }
+    return result;
+}
+
+//-------------------------------------------------------------------------------------------------
+// Test that writer produces the same output as stream manipulators
+//-------------------------------------------------------------------------------------------------
+template<typename REPO>
+void
+test_writer(const REPO& r)
+{
+    using O3::io::json::kind;
+    for (auto k : { kind::like, kind::proper, kind::d3 }) {
+        assert(written(r, k) == streamed(r, k));
+        assert(written(r, k, false) == squeeze(streamed(r, k)));
+    }
+}
+
+//-------------------------------------------------------------------------------------------------
+// Test that collections read back from proper and d3 formats are identical to the original
+//-------------------------------------------------------------------------------------------------
+template<typename REPO>
+void
+test_reader(const REPO& r)
+{
+    using O3::io::json::kind;
+    for (auto k : { kind::proper, kind::d3 }) {
+        for (bool pretty : { true, false }) {
+            REPO c;
+            O3::io::json::read(written(r, k, pretty), c, k);
+            assert(c == r);
+
+            REPO s;
+            std::istringstream is(written(r, k, pretty));
+            O3::io::json::read(is, s, k);
+            assert(s == r);
+        }
+    }
+}
+
+//-------------------------------------------------------------------------------------------------
+// Test reading input that was not produced by the writer
+//-------------------------------------------------------------------------------------------------
+void
+test_parsing()
+{
+    using O3::io::json::kind;
+    using O3::io::json::read;
+    using O3::io::json::parse_error;
+
+    O3::collection::otriemap<std::string, std::string, int> r;
+    read(R"( { "a\"b" : { "data" : "x\u00e9\n", "7" : { "data" : null } }, "data" : "root" } )", r);
+    assert(*r.find() == "root" && *r.find("a\"b") == "x\xc3\xa9\n" && r.find("a\"b", 7) == nullptr);
+
+    O3::collection::otriemap<int, std::string> d;
+    read(R"({"children":[{"name":"x","type":"ignored","data":1,"extra":{"a":[1,{"b":"]"}]}}],"data":0})", d, kind::d3);
+    assert(*d.find() == 0 && *d.find("x") == 1 && d.size() == 2);
+
+    // Objects without data beneath them leave no nodes behind
+    O3::collection::otriemap<int, std::string, std::string> e;
+    read(R"({"x":{"y":{}},"z":{}})", e);
+    assert(e.count() == 1 && e.size() == 0 && e == decltype(e)());
+    read(R"({"children":[{"name":"x","children":[{"name":"y"}]},{"name":"z","children":[]}]})", e, kind::d3);
+    assert(e.count() == 1 && e.size() == 0 && e == decltype(e)());
+    read(R"({"x":{"y":{}},"z":{"w":{"data":1}}})", e);
+    assert(e.count() == 3 && e.size() == 1 && *e.find("z", "w") == 1);
+
+    auto fails = [](const char* text, kind k = kind::proper) {
+        try {
+            O3::collection::otriemap<int, std::string> c;
+            read(text, c, k);
+        } catch (const parse_error&) {
+            return true;
+        }
+        return false;
+    };
+    assert(fails(""));
+    assert(fails("{"));
+    assert(fails(R"({"data":1} x)"));
+    assert(fails(R"({"a":{"b":{}}})"));
+    assert(fails(R"({"data":"one"})"));
+    assert(fails(R"({"children":[{"data":1,"name":"x"}]})", kind::d3));
+    assert(fails("{}", kind::like));
+}
+
+//-------------------------------------------------------------------------------------------------
+// Test that collections loaded from binary format are identical to the original
+//-------------------------------------------------------------------------------------------------
+template<typename REPO>
+void
+test_binary(const REPO& r)
+{
+    REPO c;
+    c.insert(typename REPO::data_type());
+    O3::io::binary::load(O3::io::binary::save(r), c);
+    assert(c == r);
+
+    std::stringstream ss;
+    O3::io::binary::save(ss, r);
+    REPO s;
+    O3::io::binary::load(ss, s);
+    assert(s == r);
+}
+
+//-------------------------------------------------------------------------------------------------
+// Test binary layout and rejection of malformed input
+//-------------------------------------------------------------------------------------------------
+void
+test_binary_format()
+{
+    using O3::io::binary::format_error;
+    using O3::io::binary::load;
+    using O3::io::binary::save;
+
+    O3::collection::otriemap<int, int> r;
+    r.insert(-1);
+    r.insert(300, 2);
+    assert(save(r) == std::string("O3TM\x01\x01\x03\x01\x04\x01\xd8\x04", 12));
+
+    auto fails = [](const std::string& bytes) {
+        try {
+            O3::collection::otriemap<int, int> c;
+            load(bytes, c);
+        } catch (const format_error&) {
+            return true;
+        }
+        return false;
+    };
+    assert(!fails(save(r)));
+    assert(fails(save(r).substr(0, 11)));
+    assert(fails(save(r) + '\0'));
+    assert(fails("O3TX" + save(r).substr(4)));
+    assert(fails(save(O3::collection::otriemap<int, int, int>())));
+
+    // A corrupted number of children fails at the end of input instead of sizing the container for it
+    bool failed = false;
+    try {
+        O3::collection::utriemap<int, int> u;
+        load(std::string("O3TM\x01\x01\xfe\xff\xff\xff\xff\xff\xff\xff\x7f\x02\x01", 17), u);
+    } catch (const format_error&) {
+        failed = true;
+    }
+    assert(failed);
+}
+
+//-------------------------------------------------------------------------------------------------
+// Return output of the function exporting to a temporary file
+//-------------------------------------------------------------------------------------------------
+template<typename F>
+std::string
+exported(F&& f)
+{
+    std::FILE* fp = std::tmpfile();
+    assert(fp != nullptr);
+
+    auto st = f(O3::io::exporter(fileno(fp), 16, 2));
+
+    std::string out(st.bytes, '\0');
+    std::rewind(fp);
+    assert(std::fread(out.data(), 1, out.size(), fp) == out.size() && std::fgetc(fp) == EOF);
+    std::fclose(fp);
+    return out;
+}
+
+//-------------------------------------------------------------------------------------------------
+// Test that exporting in small chunks produces the same output as the writer
+//-------------------------------------------------------------------------------------------------
+template<typename REPO>
+void
+test_exporter(const REPO& r)
+{
+    using O3::io::json::kind;
+    for (auto k : { kind::like, kind::proper, kind::d3 }) {
+        for (bool pretty : { true, false }) {
+            auto out = exported([&](O3::io::exporter&& e) { return e.json(r, k, pretty); });
+            assert(out == written(r, k, pretty));
+        }
+    }
+}
+
+int
+main(int, char*[])
+{
+    O3::collection::otriemap<char, std::string, std::string> c;
+    test_writer(c);
+
+    c.insert('0');
+    c.insert('B', "b");
+    c.insert('C', "a", "c");
+    c.insert('D', "a", "d");
+    c.insert('E', "b", "e");
+    test_writer(c);
+    test_reader(c);
+    test_binary(c);
+    test_exporter(c);
+    assert(exported([&](O3::io::exporter&& e) { return e.lines(c, '/'); }) == "0\na/c/C\na/d/D\nb/B\nb/e/E\n");
+
+    O3::collection::octriemap<char, std::string, std::string> oc;
+    O3::collection::uctriemap<char, std::string, std::string> uc;
+    c.traverse_pre([&](const auto& n, auto&&... ps) {
+        if (n) {
+            oc.insert(*n, ps...);
+            uc.insert(*n, ps...);
+        }
+        return true;
+    });
+    test_binary(oc);
+    test_binary(uc);
+
+    O3::collection::utriemap<double, int, char> d;
+    d.insert(0.1, 1);
+    d.insert(1e-7, 1, 'x');
+    d.insert(-12345678.9, 2, 'y');
+    d.insert(42, 3, 'z');
+    test_writer(d);
+    test_binary(d);
+
+    O3::collection::utriemap<long, int, char> l;
+    l.insert(-1, 1);
+    l.insert(1L << 40, 1, 'x');
+    l.insert(7, 2, 'y');
+    test_reader(l);
+    test_binary(l);
+
+    O3::collection::otriemap<bool, std::string, unsigned> b;
+    b.insert(true, "feature");
+    b.insert(false, "feature", 7u);
+    test_writer(b);
+    test_reader(b);
+    test_binary(b);
+
+    // Boolean prefixes are written as numbers
+    O3::collection::otriemap<int, bool, bool> f;
+    f.insert(1, true);
+    f.insert(2, false, true);
+    test_writer(f);
+    test_reader(f);
+    test_binary(f);
+
+    O3::collection::otriemap<Data, std::string> u;
+    u.insert(Data{ 'X' }, "x");
+    test_writer(u);
+    test_reader(u);
+    test_binary(u);
+
+    // Nested collection shares indentation with the enclosing one
+    using Inner = O3::collection::otriemap<Data, std::string, std::string>;
+    O3::collection::otriemap<Inner, std::string> n;
+    n.insert(Inner(), "Europe").first->insert(Data{ 'A' }, "Sales", "Retail");
+    n.insert(Inner(), "Europe").first->insert(Data{ 'B' }, "Services");
+    n.insert(Inner(), "Asia");
+    test_writer(n);
+    test_reader(n);
+    test_binary(n);
+    test_exporter(n);
+
+    test_parsing();
+    test_binary_format();
+
+    std::cout << "All io tests passed." << std::endl;
+
+    return 0;
+}
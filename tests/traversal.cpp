@@ -100,6 +100,10 @@ post_order_climb(const REPO& r, QS&&... qs)
 using orepo = O3::collection::otriemap<char, std::string, std::string>;
 using urepo = O3::collection::utriemap<char, std::string, std::string>;
 
+// Path-compressed collections must traverse the same way.
+using ocrepo = O3::collection::octriemap<char, std::string, std::string>;
+using ucrepo = O3::collection::uctriemap<char, std::string, std::string>;
+
 // Check if two strings contain the same letters - rather unorthodox use of operator overloading.
 bool operator &= (const std::string& l, const std::string& r)
 {
@@ -228,6 +232,33 @@ main(int, char* [])
     assert(post_order_climb(o, "b", "e") == post_order_climb(u, "b", "e"));
     assert(post_order_climb(o, "b", "f") == post_order_climb(u, "b", "f"));
 
+    // Path-compressed collections traverse like their uncompressed counterparts
+    ocrepo oc;
+    ucrepo uc;
+
+    oc.insert('C', "a", "c");   uc.insert('C', "a", "c");
+    assert(pre_order_traversal(oc) == "C" && post_order_climb(oc, "a", "c") == "C");
+    assert(pre_order_traversal(uc) == "C" && post_order_climb(uc, "a", "c") == "C");
+
+    oc.insert('0');             uc.insert('0');
+    oc.insert('A', "a");        uc.insert('A', "a");
+    oc.insert('B', "b");        uc.insert('B', "b");
+    oc.insert('D', "a", "d");   uc.insert('D', "a", "d");
+    oc.insert('E', "b", "e");   uc.insert('E', "b", "e");
+    oc.insert('F', "b", "f");   uc.insert('F', "b", "f");
+
+    assert(level_order_traversal(oc, "a") ==  level_order_traversal(o, "a"));
+    assert( pre_order_traversal(oc)       ==  pre_order_traversal(o));
+    assert(post_order_traversal(oc)       == post_order_traversal(o));
+    assert( pre_order_climb(oc, "b", "f") ==  pre_order_climb(o, "b", "f"));
+    assert(post_order_climb(oc, "a", "x") == post_order_climb(o, "a", "x"));
+
+    assert(level_order_traversal(uc, "a") &= level_order_traversal(o, "a"));
+    assert( pre_order_traversal(uc)       &=  pre_order_traversal(o));
+    assert(post_order_traversal(uc)       &= post_order_traversal(o));
+    assert( pre_order_climb(uc, "b", "f") ==  pre_order_climb(o, "b", "f"));
+    assert(post_order_climb(uc, "a", "x") == post_order_climb(o, "a", "x"));
+
     std::cout << "All traversal tests passed." << std::endl;
 
     return 0;
@@ -0,0 +1,104 @@
+/*
+ Copyright (c) 2022, Slawomir Kuzniar.
+ Distributed under the MIT License (http://opensource.org/licenses/MIT).
+*/
+
+#ifndef O3_ALGO_DIFF_DOT_H
+#define O3_ALGO_DIFF_DOT_H
+
+#include "triemap/triemap.h"
+
+namespace O3 {
+namespace algo {
+
+// Kind of difference reported by diff
+enum class change
+{
+    added,
+    removed,
+    changed
+};
+
+namespace detail {
+
+// Report every data element of the subtree as added or removed
+template<typename N, typename F, typename... PS>
+void
+diff_all(const N& n, change c, F& f, const PS&... ps)
+{
+    const typename N::data_type* none = nullptr;
+    if (n) {
+        if (c == change::added) {
+            f(c, none, &*n, ps...);
+        } else {
+            f(c, &*n, none, ps...);
+        }
+    }
+    n.traverse_level([&](const auto& sn, const auto& sp) {
+        diff_all(sn, c, f, ps..., sp);
+        return true;
+    });
+}
+
+template<typename N, typename F, typename... PS>
+void
+diff(const N& a, const N& b, F& f, const PS&... ps)
+{
+    if constexpr (O3::collection::details::is_hashed<typename N::store_type>::value) {
+        if (a.digest() == b.digest()) {
+            return;
+        }
+    }
+
+    const typename N::data_type* none = nullptr;
+    if (a && b) {
+        if (!(*a == *b)) {
+            f(change::changed, &*a, &*b, ps...);
+        }
+    } else if (a) {
+        f(change::removed, &*a, none, ps...);
+    } else if (b) {
+        f(change::added, none, &*b, ps...);
+    }
+
+    a.traverse_level([&](const auto& sa, const auto& sp) {
+        bool found = false;
+        b.jump(
+            [&](const auto& sb) {
+                found = true;
+                diff(sa, sb, f, ps..., sp);
+            },
+            sp);
+        if (!found) {
+            diff_all(sa, change::removed, f, ps..., sp);
+        }
+        return true;
+    });
+    b.traverse_level([&](const auto& sb, const auto& sp) {
+        bool found = false;
+        a.jump([&](const auto&) { found = true; }, sp);
+        if (!found) {
+            diff_all(sb, change::added, f, ps..., sp);
+        }
+        return true;
+    });
+}
+
+} // namespace detail
+
+// Report differences between two trie-maps. The function is called as f(change, before, after, prefixes...) for every key
+// path whose data was added, removed or changed; before or after is null for added and removed data. A node is reported
+// before its children, and children present in the first trie-map before those present only in the second. With
+// hashed_policy subtrees with the same hash are skipped, so the cost depends on the size of the differences, not the
+// size of the trie-maps.
+template<typename TM, typename F>
+void
+diff(const TM& a, const TM& b, F&& f)
+{
+    detail::diff(a, b, f);
+}
+
+} // namespace algo
+} // namespace O3
+
+#endif
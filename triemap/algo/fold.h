@@ -0,0 +1,187 @@
+/*
+ Copyright (c) 2022, Slawomir Kuzniar.
+ Distributed under the MIT License (http://opensource.org/licenses/MIT).
+*/
+
+#ifndef O3_ALGO_FOLD_DOT_H
+#define O3_ALGO_FOLD_DOT_H
+
+#include <vector>
+#include <optional>
+#include <utility>
+#include <type_traits>
+
+#include "triemap/triemap.h"
+
+namespace O3 {
+namespace algo {
+
+namespace detail {
+
+// Fold a contiguous run of values with independent accumulators, which the compiler can keep in vector registers. The
+// order of combining differs from a left fold, so op must be associative and commutative.
+template<typename D, typename OP>
+D
+fold_lanes(const D* v, size_t n, OP& op)
+{
+    constexpr size_t lanes = 8;
+
+    size_t i = 0;
+    if (n >= lanes) {
+        D acc[lanes];
+        for (size_t l = 0; l < lanes; ++l) {
+            acc[l] = v[l];
+        }
+        for (i = lanes; i + lanes <= n; i += lanes) {
+            for (size_t l = 0; l < lanes; ++l) {
+                acc[l] = op(acc[l], v[i + l]);
+            }
+        }
+        for (size_t l = 1; l < lanes; ++l) {
+            acc[0] = op(acc[0], acc[l]);
+        }
+        D r = acc[0];
+        for (; i < n; ++i) {
+            r = op(r, v[i]);
+        }
+        return r;
+    }
+
+    D r = v[0];
+    for (i = 1; i < n; ++i) {
+        r = op(r, v[i]);
+    }
+    return r;
+}
+
+// Data gathered into a buffer and folded in lanes. Booleans are folded child by child, as std::vector<bool> packs them
+// into bits instead of a contiguous run.
+template<typename D>
+constexpr bool in_lanes = std::is_arithmetic_v<D> && !std::is_same_v<D, bool>;
+
+// Combine data of the children into the node. Arithmetic data is gathered into a reused buffer and folded there,
+// anything else is folded child by child.
+template<typename N, typename OP, typename B>
+void
+fold_children(N& n, OP& op, B& buf)
+{
+    using data_type = typename N::data_type;
+
+    std::optional<data_type> acc;
+    if constexpr (in_lanes<data_type>) {
+        buf.clear();
+        std::as_const(n).traverse_level([&](const auto& c, const auto&) {
+            if (c) {
+                buf.push_back(*c);
+            }
+            return true;
+        });
+        if (!buf.empty()) {
+            acc = fold_lanes(buf.data(), buf.size(), op);
+        }
+    } else {
+        std::as_const(n).traverse_level([&](const auto& c, const auto&) {
+            if (c) {
+                acc = acc ? op(std::as_const(*acc), *c) : *c;
+            }
+            return true;
+        });
+    }
+
+    if (!acc) {
+        return;
+    }
+    if (n) {
+        n.update([&](data_type& d) { d = op(std::as_const(d), std::as_const(*acc)); });
+    } else {
+        n.insert(std::move(*acc));
+    }
+}
+
+} // namespace detail
+
+// Combine data into parents bottom-up. Every node with data below it ends up holding op folded over its own data and
+// the folded data of its children, so with std::plus the root holds the sum of the whole trie-map. Nodes without data
+// receive the fold of their children. Children are combined in container order, or in several interleaved runs for
+// arithmetic data, so op must be associative and commutative.
+template<typename TM, typename OP>
+void
+fold_up(TM& tm, OP&& op)
+{
+    std::vector<typename TM::data_type> buf;
+    tm.traverse_post([&](auto& n, auto&&...) {
+        if (!n.leaf()) {
+            detail::fold_children(n, op, buf);
+        }
+        return true;
+    });
+}
+
+// Propagate data to children top-down. Children without data receive the data of their parent, so every node below a
+// node with data ends up with the nearest data above it, as defaults in a hierarchical configuration.
+template<typename TM>
+void
+fold_down(TM& tm)
+{
+    tm.traverse_pre([&](auto& n, auto&&...) {
+        if (n) {
+            n.traverse_level([&](auto& c, const auto&) {
+                if (!c) {
+                    c.insert(*std::as_const(n));
+                }
+                return true;
+            });
+        }
+        return true;
+    });
+}
+
+// Propagate data to children top-down, replacing data of children that have it by op(parent, child)
+template<typename TM, typename OP>
+void
+fold_down(TM& tm, OP&& op)
+{
+    tm.traverse_pre([&](auto& n, auto&&...) {
+        if (n) {
+            const auto& p = *std::as_const(n);
+            n.traverse_level([&](auto& c, const auto&) {
+                if (c) {
+                    c.update([&](auto& d) { d = op(p, std::as_const(d)); });
+                } else {
+                    c.insert(p);
+                }
+                return true;
+            });
+        }
+        return true;
+    });
+}
+
+// Inclusive scan along every path from the root. Data of a node becomes op(scanned data of the nearest ancestor with
+// data, data of the node). Nodes without data are left empty and pass the scanned data of their ancestors through.
+template<typename TM, typename OP>
+void
+scan(TM& tm, OP&& op)
+{
+    using data_type = typename TM::data_type;
+
+    std::vector<const data_type*> path{ nullptr };
+    tm.traverse_dfs(
+        [&](auto& n, auto&&...) {
+            if (n && path.back()) {
+                const auto& p = *path.back();
+                n.update([&](data_type& d) { d = op(p, std::as_const(d)); });
+            }
+            path.push_back(n ? &*std::as_const(n) : path.back());
+            return true;
+        },
+        [&](auto&, auto&&...) {
+            path.pop_back();
+            return true;
+        });
+}
+
+} // namespace algo
+} // namespace O3
+
+#endif
@@ -0,0 +1,106 @@
+/*
+ Copyright (c) 2022, Slawomir Kuzniar.
+ Distributed under the MIT License (http://opensource.org/licenses/MIT).
+*/
+
+#ifndef O3_ALGO_MERGE_DOT_H
+#define O3_ALGO_MERGE_DOT_H
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <utility>
+#include <exception>
+#include <algorithm>
+
+#include "triemap/triemap.h"
+
+namespace O3 {
+namespace algo {
+
+// Data collision policy that keeps the data of the destination
+struct keep
+{
+    template<typename D>
+    void operator()(D&, D&&) const
+    {}
+};
+
+// Data collision policy that replaces the data of the destination
+struct overwrite
+{
+    template<typename D>
+    void operator()(D& dst, D&& src) const
+    {
+        dst = std::move(src);
+    }
+};
+
+// Data collision policy that replaces the data of the destination with f(dst, src)
+template<typename F>
+struct combine
+{
+    F f;
+
+    explicit combine(F fn)
+      : f(std::move(fn))
+    {}
+
+    template<typename D>
+    void operator()(D& dst, D&& src) const
+    {
+        dst = f(std::as_const(dst), std::move(src));
+    }
+};
+
+// Merge source trie-map into destination and leave the source empty. Subtrees missing in the destination are spliced
+// over without copying their elements, subtrees present in both are merged recursively, and data collisions are resolved
+// by the policy. With more than one thread, children of the root present in both trie-maps are merged in parallel, so
+// the policy must be safe to call concurrently.
+template<typename TM, typename POLICY>
+void
+merge(TM& dst, TM&& src, POLICY&& policy, size_t threads = 1)
+{
+    if (threads > 1) {
+        std::vector<std::pair<typename TM::child_type*, typename TM::child_type*>> both;
+        src.traverse_level([&](auto& sn, const auto& sp) {
+            dst.jump([&](auto& dn) { both.emplace_back(&dn, &sn); }, sp);
+            return true;
+        });
+
+        std::atomic<size_t> next{ 0 };
+        std::exception_ptr  error;
+        std::atomic<bool>   failed{ false };
+        auto                work = [&] {
+            for (size_t i = next++; i < both.size() && !failed; i = next++) {
+                try {
+                    both[i].first->merge(std::move(*both[i].second), policy);
+                } catch (...) {
+                    if (!failed.exchange(true)) {
+                        error = std::current_exception();
+                    }
+                }
+            }
+        };
+
+        std::vector<std::thread> pool;
+        for (size_t t = 1; t < std::min(threads, both.size()); ++t) {
+            pool.emplace_back(work);
+        }
+        work();
+        for (auto& t : pool) {
+            t.join();
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    // Children merged above are empty in the source now and cost a lookup each
+    dst.merge(std::move(src), std::forward<POLICY>(policy));
+}
+
+} // namespace algo
+} // namespace O3
+
+#endif
@@ -0,0 +1,271 @@
+/*
+ Copyright (c) 2022, Slawomir Kuzniar.
+ Distributed under the MIT License (http://opensource.org/licenses/MIT).
+*/
+
+#ifndef O3_ALGO_PIVOT_DOT_H
+#define O3_ALGO_PIVOT_DOT_H
+
+#include <array>
+#include <tuple>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+#include <type_traits>
+
+#include "triemap/triemap.h"
+
+namespace O3 {
+namespace algo {
+
+namespace detail {
+
+// Policy with the fan-out hints reordered like the prefixes, so that level J is sized as level I_J of the source.
+// Policies without hints are kept as they are.
+template<typename POLICY, size_t... I>
+struct rehinted : POLICY
+{
+    static constexpr std::array<size_t, sizeof...(I)> fanout{ POLICY::fanout[I]... };
+};
+
+template<typename POLICY, size_t... I>
+struct pivoted_policy
+{
+    using type =
+        std::conditional_t<collection::details::fanout_hint<POLICY>::levels == 0, POLICY, rehinted<POLICY, I...>>;
+};
+
+// Hints of the stock policy are reordered in place, so pivoting back gives the type of the source again
+template<typename BASE, size_t... F, size_t... I>
+struct pivoted_policy<collection::basic_fanout_policy<BASE, F...>, I...>
+{
+    using type = collection::basic_fanout_policy<BASE, collection::basic_fanout_policy<BASE, F...>::fanout[I]...>;
+};
+
+// Trie-map with the same container and data, and the prefixes and fan-out hints reordered so that level J holds
+// prefix I_J
+template<typename TM, size_t... I>
+struct pivoted;
+
+template<template<typename K, typename T> class MAP, typename POLICY, typename DATA, typename... PFIXS, size_t... I>
+struct pivoted<collection::details::triemap<MAP, POLICY, DATA, PFIXS...>, I...>
+{
+    using keys_type   = std::tuple<PFIXS...>;
+    using policy_type = typename collection::details::policy_for<typename pivoted_policy<POLICY, I...>::type,
+                                                                 sizeof...(I)>::type;
+    using type        = collection::details::triemap<MAP, policy_type, DATA, std::tuple_element_t<I, keys_type>...>;
+};
+
+template<size_t... I>
+constexpr bool is_permutation()
+{
+    constexpr size_t               n = sizeof...(I);
+    constexpr std::array<size_t, n> order{ I... };
+    std::array<bool, n + 1>         seen{};
+    for (size_t i : order) {
+        if (i >= n || seen[i]) {
+            return false;
+        }
+        seen[i] = true;
+    }
+    return true;
+}
+
+// Number of leading levels that have to be sorted. A sorted source is traversed in the order of its prefixes, so the
+// trailing levels that keep their relative order are already sorted within each run of the leading ones.
+template<size_t... I>
+constexpr size_t unsorted_levels()
+{
+    constexpr std::array<size_t, sizeof...(I)> order{ I... };
+    size_t                                     k = order.size();
+    while (k > 1 && order[k - 2] < order[k - 1]) {
+        --k;
+    }
+    return k > 0 ? k - 1 : 0;
+}
+
+// Lexicographical order of the first K prefixes
+template<size_t K, size_t L = 0, typename KEYS>
+bool
+less(const KEYS& a, const KEYS& b)
+{
+    if constexpr (L < K) {
+        if (std::get<L>(a) < std::get<L>(b)) {
+            return true;
+        }
+        if (std::get<L>(b) < std::get<L>(a)) {
+            return false;
+        }
+        return less<K, L + 1>(a, b);
+    }
+    return false;
+}
+
+// Data element on its way to the target, with the prefixes in target order and trailing ones defaulted
+template<typename KEYS, typename DATA>
+struct entry
+{
+    size_t depth;
+    size_t common; // Number of leading prefixes shared with the previous entry
+    KEYS   keys;
+    DATA   data;
+};
+
+template<size_t L = 0, typename KEYS>
+size_t
+common(const KEYS& a, size_t da, const KEYS& b, size_t db)
+{
+    if constexpr (L < std::tuple_size_v<KEYS>) {
+        if (L < da && L < db && std::get<L>(a) == std::get<L>(b)) {
+            return common<L + 1>(a, da, b, db);
+        }
+    }
+    return L;
+}
+
+// Descend along the entry from level L, reusing nodes shared with the previous entry and appending the rest
+template<size_t L, typename CURSOR, typename E>
+void
+place(CURSOR& cur, E& e)
+{
+    auto& n = *std::get<L>(cur);
+    if constexpr (L + 1 < std::tuple_size_v<CURSOR>) {
+        if (L < e.depth) {
+            if (L >= e.common) {
+                std::get<L + 1>(cur) = &n.append(std::move(std::get<L>(e.keys)));
+            }
+            place<L + 1>(cur, e);
+            return;
+        }
+    }
+    n.insert(std::move(e.data));
+}
+
+template<typename TM, size_t... L>
+auto
+make_cursor(TM& tm, std::index_sequence<L...>)
+{
+    std::tuple<typename collection::details::node_at<TM, L>::type*...> cur;
+    std::get<0>(cur) = &tm;
+    return cur;
+}
+
+template<size_t... I, typename KEYS, size_t... J>
+auto
+permute(const KEYS& src, size_t depth, std::index_sequence<J...>)
+{
+    std::tuple<std::tuple_element_t<I, KEYS>...> dst;
+    ((J < depth ? void(std::get<J>(dst) = std::get<I>(src)) : void()), ...);
+    return dst;
+}
+
+// Insert data with the first prefixes of the target, picked from a source path
+template<size_t... I, typename TM, typename D, typename KEYS, size_t... J>
+void
+insert_at(TM& tm, D&& d, const KEYS& src, std::index_sequence<J...>)
+{
+    [[maybe_unused]] constexpr std::array<size_t, sizeof...(I)> order{ I... };
+    tm.insert(std::forward<D>(d), std::get<order[J]>(src)...);
+}
+
+} // namespace detail
+
+//----------------------------------------------------------------------------------------------------------------------
+// Return trie-map with the prefixes reordered by a permutation, so that level J of the result is keyed by prefix I_J of
+// the source. For trie-map keyed by feature, division, department and id, pivot<3, 0, 1, 2> gives one keyed by id,
+// feature, division and department. Fan-out hints of the policy move with their levels. Ordered trie-maps collect data
+// elements with their prefixes in target order and sort them by the levels that change their relative order, the
+// permutation above sorts by id alone. The result is then built top-down on the append path, moving the prefixes into
+// place and reusing the nodes shared with the previous element, so every child is created once and without a search.
+// Unordered trie-maps gain nothing from the order and insert during the traversal instead. Data is moved out of an
+// rvalue source and copied otherwise.
+//
+// Data above the last level keeps its place only if its prefixes map onto the leading levels of the result, for
+// pivot<1, 0, 2> data at depth 2 does and data at depth 1 does not. Anything else throws std::invalid_argument.
+//----------------------------------------------------------------------------------------------------------------------
+template<size_t... I, typename TM>
+auto
+pivot(TM&& tm)
+{
+    using source_type = std::decay_t<TM>;
+    using keys_type   = typename collection::details::prefixes_of<source_type>::type;
+    using target_type = typename detail::pivoted<source_type, I...>::type;
+    using target_keys = typename collection::details::prefixes_of<target_type>::type;
+    using data_type   = typename source_type::data_type;
+    using entry_type  = detail::entry<target_keys, data_type>;
+
+    constexpr size_t levels = std::tuple_size_v<keys_type>;
+    static_assert(sizeof...(I) == levels, "Permutation must name every level");
+    static_assert(detail::is_permutation<I...>(), "Indices must be a permutation of the levels");
+
+    constexpr bool sorted = collection::details::is_sorted<typename target_type::repo_type>::value;
+    constexpr std::array<size_t, levels> order{ I... };
+    auto closed = [&](size_t depth) {
+        return std::all_of(order.begin(), order.begin() + depth, [&](size_t i) { return i < depth; });
+    };
+
+    // Data leaves an rvalue source by move
+    auto take = [](auto& d) -> decltype(auto) {
+        if constexpr (std::is_lvalue_reference_v<TM>) {
+            return std::as_const(d);
+        } else {
+            return std::move(d);
+        }
+    };
+
+    target_type             target;
+    std::vector<entry_type> entries;
+    keys_type               path;
+    auto                    collect = [&](auto& n, const auto&... qs) {
+        constexpr size_t depth =
+            levels - std::tuple_size_v<typename collection::details::prefixes_of<std::decay_t<decltype(n)>>::type>;
+        if constexpr (depth > 0) {
+            ((std::get<depth - 1>(path) = qs), ...);
+        }
+        if (n) {
+            if (!closed(depth)) {
+                throw std::invalid_argument("Data above the last level does not fit the permutation");
+            }
+            if constexpr (sorted) {
+                entries.push_back(
+                    { depth, 0, detail::permute<I...>(path, depth, std::make_index_sequence<levels>()), take(*n) });
+            } else {
+                detail::insert_at<I...>(target, take(*n), path, std::make_index_sequence<depth>());
+            }
+        }
+        return true;
+    };
+    auto leave = [](const auto&, const auto&...) { return true; };
+    if constexpr (std::is_lvalue_reference_v<TM>) {
+        std::as_const(tm).traverse_dfs(collect, leave);
+    } else {
+        tm.traverse_dfs(collect, leave);
+    }
+
+    if constexpr (sorted) {
+        constexpr size_t unsorted = detail::unsorted_levels<I...>();
+        if constexpr (unsorted > 0) {
+            std::stable_sort(entries.begin(), entries.end(), [](const entry_type& a, const entry_type& b) {
+                return detail::less<unsorted>(a.keys, b.keys);
+            });
+        }
+
+        // Shared prefixes are found before they are moved out
+        for (size_t e = 1; e < entries.size(); ++e) {
+            const auto& prev  = entries[e - 1];
+            entries[e].common = detail::common(prev.keys, prev.depth, entries[e].keys, entries[e].depth);
+        }
+
+        auto cursor = detail::make_cursor(target, std::make_index_sequence<levels + 1>());
+        for (auto& e : entries) {
+            detail::place<0>(cursor, e);
+        }
+    }
+    return target;
+}
+
+} // namespace algo
+} // namespace O3
+
+#endif
@@ -0,0 +1,319 @@
+/*
+ Copyright (c) 2022, Slawomir Kuzniar.
+ Distributed under the MIT License (http://opensource.org/licenses/MIT).
+*/
+
+#ifndef O3_COLLECTION_EXPIRING_DOT_H
+#define O3_COLLECTION_EXPIRING_DOT_H
+
+#include <map>
+#include <list>
+#include <array>
+#include <tuple>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+#include <type_traits>
+
+#include "triemap/triemap.h"
+
+namespace O3::collection {
+
+namespace details {
+
+// Index of the lowest set bit of a non-zero mask
+inline size_t lowest_bit(uint64_t m)
+{
+    static constexpr std::array<uint8_t, 64> table = { 0,  1,  48, 2,  57, 49, 28, 3,  61, 58, 50, 42, 38, 29, 17, 4,
+                                                       62, 55, 59, 36, 53, 51, 43, 22, 45, 39, 33, 30, 24, 18, 12, 5,
+                                                       63, 47, 56, 27, 60, 41, 37, 16, 54, 35, 52, 21, 44, 32, 23, 11,
+                                                       46, 26, 40, 15, 34, 20, 31, 10, 25, 14, 19, 9,  13, 8,  7,  6 };
+    return table[((m & (~m + 1)) * 0x03f79d71b4cb0a89ull) >> 58];
+}
+
+} // namespace details
+
+//----------------------------------------------------------------------------------------------------------------------
+// Trie-map whose data can expire. Expiring data is tracked by a hierarchical timer wheel, and advance(now) erases the
+// data that is due, together with the parents it leaves empty, without looking at the rest of the trie-map. Time is
+// counted in ticks of any unit and only moves forward through advance. Like indexed, the trie-map is only modified
+// through the wrapper and is otherwise read through trie(). Prefixes must be ordered.
+//----------------------------------------------------------------------------------------------------------------------
+template<typename TM>
+class expiring
+{
+public:
+    using trie_type = TM;
+    using data_type = typename TM::data_type;
+    using keys_type = typename details::prefixes_of<TM>::type;
+    using path_type = typename details::key_path<keys_type>::type;
+    using time_type = uint64_t;
+
+    static constexpr size_t levels = std::tuple_size_v<keys_type>;
+
+    explicit expiring(time_type now = 0)
+      : m_now(now)
+    {}
+
+    // The index refers to timers through iterators, which survive a move but not a copy
+    expiring(const expiring&)            = delete;
+    expiring& operator=(const expiring&) = delete;
+    expiring(expiring&&) noexcept        = default;
+    expiring& operator=(expiring&&)      = default;
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Trie-map for reading
+    //------------------------------------------------------------------------------------------------------------------
+    const TM& trie() const
+    {
+        return m_tm;
+    }
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Current time
+    //------------------------------------------------------------------------------------------------------------------
+    [[nodiscard]] time_type now() const
+    {
+        return m_now;
+    }
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Insert data that does not expire, or return existing data
+    //------------------------------------------------------------------------------------------------------------------
+    template<class D, typename... PS>
+    std::pair<const data_type*, bool> insert(D&& data, PS&&... ps)
+    {
+        return m_tm.insert(std::forward<D>(data), std::forward<PS>(ps)...);
+    }
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Insert data that expires ttl ticks from now, or return existing data and leave its expiry as it is. Data with zero
+    // ttl expires at the next tick.
+    //------------------------------------------------------------------------------------------------------------------
+    template<class D, typename... PS>
+    std::pair<const data_type*, bool> insert_for(time_type ttl, D&& data, PS&&... ps)
+    {
+        auto rv = m_tm.insert(std::forward<D>(data), ps...);
+        if (rv.second) {
+            schedule(key_path::make(ps...), ttl);
+        }
+        return rv;
+    }
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Let existing data expire ttl ticks from now, replacing any earlier expiry. Return false if there is no data.
+    //------------------------------------------------------------------------------------------------------------------
+    template<typename... PS>
+    bool expire(time_type ttl, PS&&... ps)
+    {
+        if (std::as_const(m_tm).find(ps...) == nullptr) {
+            return false;
+        }
+        schedule(key_path::make(ps...), ttl);
+        return true;
+    }
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Keep existing data from expiring. Return false if it was not going to expire.
+    //------------------------------------------------------------------------------------------------------------------
+    template<typename... PS>
+    bool persist(PS&&... ps)
+    {
+        return cancel(key_path::make(ps...));
+    }
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Apply f to the data given the list of prefixes, return false if there is none. The expiry is not changed.
+    //------------------------------------------------------------------------------------------------------------------
+    template<typename F, typename... PS>
+    bool update(F&& f, PS&&... ps)
+    {
+        return m_tm.update(std::forward<F>(f), std::forward<PS>(ps)...);
+    }
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Erase data given the list of prefixes
+    //------------------------------------------------------------------------------------------------------------------
+    template<typename... PS>
+    size_t erase(PS&&... ps)
+    {
+        cancel(key_path::make(ps...));
+        return m_tm.erase(std::forward<PS>(ps)...);
+    }
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Clear all data
+    //------------------------------------------------------------------------------------------------------------------
+    void clear()
+    {
+        m_tm.clear();
+        m_timers.clear();
+        for (auto& w : m_wheel) {
+            for (auto& s : w.slots) {
+                s.clear();
+            }
+            w.occupied = 0;
+        }
+    }
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Relocate the subtree given the list of prefixes, see compact of the trie-map.
+    //------------------------------------------------------------------------------------------------------------------
+    template<typename... PS>
+    size_t compact(PS&&... ps)
+    {
+        return m_tm.compact(std::forward<PS>(ps)...);
+    }
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Move the time forward and erase the data that expired by then. Parents left empty are removed as with erase.
+    // Returns the number of erased data elements. Empty slots are skipped a wheel level at a time, so the cost depends
+    // on the number of expired and rescheduled timers rather than on the time passed or the size of the trie-map.
+    //------------------------------------------------------------------------------------------------------------------
+    size_t advance(time_type now)
+    {
+        size_t count = 0;
+        while (m_now < now) {
+            // The lowest occupied level holds the next timer or the next slot to spread over lower levels
+            auto w = std::find_if(m_wheel.begin(), m_wheel.end(), [](const wheel& w) { return w.occupied != 0; });
+            if (w == m_wheel.end()) {
+                break;
+            }
+            size_t    level = static_cast<size_t>(w - m_wheel.begin());
+            size_t    slot  = details::lowest_bit(w->occupied);
+            size_t    shift = level * bits;
+            time_type block = shift + bits < 64 ? m_now >> (shift + bits) << (shift + bits) : 0;
+            time_type start = block | static_cast<time_type>(slot) << shift;
+            if (start > now) {
+                break;
+            }
+
+            m_now = start;
+            timer_list due;
+            due.swap(w->slots[slot]);
+            w->occupied &= ~(uint64_t(1) << slot);
+            while (!due.empty()) {
+                auto itr = due.begin();
+                if (itr->deadline <= m_now) {
+                    m_timers.erase(itr->path);
+                    count += key_path::call(itr->path, [this](const auto&... ps) { return m_tm.erase(ps...); });
+                    due.erase(itr);
+                } else {
+                    place(due, itr);
+                }
+            }
+        }
+        m_now = std::max(m_now, now);
+        return count;
+    }
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Find the data given the list of prefixes
+    //------------------------------------------------------------------------------------------------------------------
+    template<typename... PS>
+    const data_type* find(PS&&... ps) const
+    {
+        return m_tm.find(std::forward<PS>(ps)...);
+    }
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Find the data element as far as possible along the list of prefixes
+    //------------------------------------------------------------------------------------------------------------------
+    template<typename... PS>
+    const data_type* match(PS&&... ps) const
+    {
+        return m_tm.match(std::forward<PS>(ps)...);
+    }
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Return the tick at which data given the list of prefixes expires, or zero if it does not
+    //------------------------------------------------------------------------------------------------------------------
+    template<typename... PS>
+    [[nodiscard]] time_type deadline(PS&&... ps) const
+    {
+        auto itr = m_timers.find(key_path::make(ps...));
+        return itr != m_timers.end() ? itr->second->deadline : 0;
+    }
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Return number of data elements and number of those that expire
+    //------------------------------------------------------------------------------------------------------------------
+    [[nodiscard]] size_t size() const
+    {
+        return m_tm.size();
+    }
+    [[nodiscard]] size_t pending() const
+    {
+        return m_timers.size();
+    }
+
+private:
+    using key_path = details::key_path<keys_type>;
+
+    // Every level splits the range of the level above into 64 slots, so 11 levels cover all 64-bit deadlines
+    static constexpr size_t bits = 6;
+
+    struct timer
+    {
+        time_type deadline;
+        path_type path;
+        size_t    level;
+        size_t    slot;
+    };
+    using timer_list = std::list<timer>;
+
+    struct wheel
+    {
+        std::array<timer_list, size_t(1) << bits> slots;
+        uint64_t                                  occupied = 0; // Bit per non-empty slot
+    };
+
+    void schedule(path_type path, time_type ttl)
+    {
+        cancel(path);
+        timer_list pending;
+        pending.push_back({ m_now + std::max(ttl, time_type(1)), path, 0, 0 });
+        m_timers.emplace(std::move(path), pending.begin());
+        place(pending, pending.begin());
+    }
+
+    bool cancel(const path_type& path)
+    {
+        auto itr = m_timers.find(path);
+        if (itr == m_timers.end()) {
+            return false;
+        }
+        auto  slot = itr->second->slot;
+        auto& w    = m_wheel[itr->second->level];
+        w.slots[slot].erase(itr->second);
+        if (w.slots[slot].empty()) {
+            w.occupied &= ~(uint64_t(1) << slot);
+        }
+        m_timers.erase(itr);
+        return true;
+    }
+
+    // Move a timer to the slot of the level where its deadline first differs from the current time
+    void place(timer_list& from, typename timer_list::iterator itr)
+    {
+        size_t level = 0;
+        for (time_type d = (itr->deadline ^ m_now) >> bits; d != 0; d >>= bits) {
+            ++level;
+        }
+        itr->level = level;
+        itr->slot  = static_cast<size_t>(itr->deadline >> (level * bits)) & ((size_t(1) << bits) - 1);
+
+        auto& w = m_wheel[level];
+        w.slots[itr->slot].splice(w.slots[itr->slot].end(), from, itr);
+        w.occupied |= uint64_t(1) << itr->slot;
+    }
+
+    TM                                                 m_tm;
+    time_type                                          m_now;
+    std::array<wheel, (64 + bits - 1) / bits>          m_wheel;
+    std::map<path_type, typename timer_list::iterator> m_timers;
+};
+
+} // namespace O3::collection
+
+#endif
@@ -0,0 +1,236 @@
+/*
+ Copyright (c) 2022, Slawomir Kuzniar.
+ Distributed under the MIT License (http://opensource.org/licenses/MIT).
+*/
+
+#ifndef O3_COLLECTION_INDEXED_DOT_H
+#define O3_COLLECTION_INDEXED_DOT_H
+
+#include <map>
+#include <set>
+#include <tuple>
+#include <optional>
+#include <utility>
+#include <type_traits>
+
+#include "triemap/triemap.h"
+
+namespace O3::collection {
+
+namespace details {
+
+// Projection that indexes the data itself
+struct same
+{
+    template<typename T>
+    const T& operator()(const T& t) const
+    {
+        return t;
+    }
+};
+
+} // namespace details
+
+//----------------------------------------------------------------------------------------------------------------------
+// Trie-map with a reverse index from data, or a projection of it, to the key paths that hold it. The trie-map is only
+// modified through insert, erase, update and clear, which keep the index in step, and is otherwise read through trie().
+// Finding the key paths of a value costs a lookup plus the number of paths, regardless of the size of the trie-map.
+// Projected values and prefixes must be ordered.
+//----------------------------------------------------------------------------------------------------------------------
+template<typename TM, typename PROJ = details::same>
+class indexed
+{
+public:
+    using trie_type  = TM;
+    using data_type  = typename TM::data_type;
+    using value_type = std::decay_t<std::invoke_result_t<const PROJ&, const data_type&>>;
+    using keys_type  = typename details::prefixes_of<TM>::type;
+    using path_type  = typename details::key_path<keys_type>::type;
+
+    static constexpr size_t levels = std::tuple_size_v<keys_type>;
+
+    explicit indexed(PROJ proj = PROJ())
+      : m_proj(std::move(proj))
+    {}
+
+    // Take over a trie-map and index its content
+    explicit indexed(TM tm, PROJ proj = PROJ())
+      : m_tm(std::move(tm))
+      , m_proj(std::move(proj))
+    {
+        path_type path;
+        std::as_const(m_tm).traverse_dfs(
+            [&](const auto& n, const auto&... qs) {
+                constexpr size_t depth = levels - std::tuple_size_v<typename details::prefixes_of<
+                                                      std::decay_t<decltype(n)>>::type>;
+                if constexpr (depth > 0) {
+                    ((std::get<depth - 1>(path.second) = qs), ...);
+                }
+                path.first = depth;
+                if (n) {
+                    add(*n, path);
+                }
+                return true;
+            },
+            [](const auto&, const auto&...) { return true; });
+    }
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Indexed trie-map for reading
+    //------------------------------------------------------------------------------------------------------------------
+    const TM& trie() const
+    {
+        return m_tm;
+    }
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Insert or return existing data given the list of prefixes
+    //------------------------------------------------------------------------------------------------------------------
+    template<class D, typename... PS>
+    std::pair<const data_type*, bool> insert(D&& data, PS&&... ps)
+    {
+        auto rv = m_tm.insert(std::forward<D>(data), ps...);
+        if (rv.second) {
+            add(*rv.first, key_path::make(ps...));
+        }
+        return rv;
+    }
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Erase data given the list of prefixes
+    //------------------------------------------------------------------------------------------------------------------
+    template<typename... PS>
+    size_t erase(PS&&... ps)
+    {
+        auto d = std::as_const(m_tm).find(ps...);
+        if (d == nullptr) {
+            return 0;
+        }
+        remove(*d, key_path::make(ps...));
+        return m_tm.erase(ps...);
+    }
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Apply f to the data given the list of prefixes, return false if there is none. The update may move the data, as
+    // versioned stores do, so the new value is projected inside it.
+    //------------------------------------------------------------------------------------------------------------------
+    template<typename F, typename... PS>
+    bool update(F&& f, PS&&... ps)
+    {
+        auto d = std::as_const(m_tm).find(ps...);
+        if (d == nullptr) {
+            return false;
+        }
+        auto                      before = m_proj(*d);
+        std::optional<value_type> after;
+        m_tm.update(
+            [&](data_type& data) {
+                f(data);
+                after.emplace(m_proj(data));
+            },
+            ps...);
+        if (before < *after || *after < before) {
+            auto path = key_path::make(ps...);
+            unlink(before, path);
+            link(std::move(*after), std::move(path));
+        }
+        return true;
+    }
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Clear all data
+    //------------------------------------------------------------------------------------------------------------------
+    void clear()
+    {
+        m_tm.clear();
+        m_index.clear();
+    }
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Relocate the subtree given the list of prefixes, see compact of the trie-map.
+    //------------------------------------------------------------------------------------------------------------------
+    template<typename... PS>
+    size_t compact(PS&&... ps)
+    {
+        return m_tm.compact(std::forward<PS>(ps)...);
+    }
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Find the data given the list of prefixes
+    //------------------------------------------------------------------------------------------------------------------
+    template<typename... PS>
+    const data_type* find(PS&&... ps) const
+    {
+        return m_tm.find(std::forward<PS>(ps)...);
+    }
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Return number of key paths holding data with the given projection
+    //------------------------------------------------------------------------------------------------------------------
+    [[nodiscard]] size_t count(const value_type& v) const
+    {
+        auto itr = m_index.find(v);
+        return itr != m_index.end() ? itr->second.size() : 0;
+    }
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Visit key paths holding data with the given projection, calling f with the prefixes of each path in order. Paths
+    // have different lengths, so f is usually a generic variadic lambda.
+    //------------------------------------------------------------------------------------------------------------------
+    template<typename F>
+    void paths(const value_type& v, F&& f) const
+    {
+        auto itr = m_index.find(v);
+        if (itr != m_index.end()) {
+            for (const auto& p : itr->second) {
+                key_path::call(p, [&](const auto&... ps) { f(ps...); });
+            }
+        }
+    }
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Return number of data elements
+    //------------------------------------------------------------------------------------------------------------------
+    [[nodiscard]] size_t size() const
+    {
+        return m_tm.size();
+    }
+
+private:
+    using key_path = details::key_path<keys_type>;
+
+    void add(const data_type& d, path_type path)
+    {
+        link(m_proj(d), std::move(path));
+    }
+
+    void link(value_type v, path_type path)
+    {
+        key_path::clear_trailing(path);
+        m_index[std::move(v)].insert(std::move(path));
+    }
+
+    void remove(const data_type& d, const path_type& path)
+    {
+        unlink(m_proj(d), path);
+    }
+
+    void unlink(const value_type& v, const path_type& path)
+    {
+        auto itr = m_index.find(v);
+        if (itr != m_index.end()) {
+            itr->second.erase(path);
+            if (itr->second.empty()) {
+                m_index.erase(itr);
+            }
+        }
+    }
+
+    TM                                        m_tm;
+    PROJ                                      m_proj;
+    std::map<value_type, std::set<path_type>> m_index;
+};
+
+} // namespace O3::collection
+
+#endif
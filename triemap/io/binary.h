@@ -0,0 +1,492 @@
+/*
+ Copyright (c) 2022, Slawomir Kuzniar.
+ Distributed under the MIT License (http://opensource.org/licenses/MIT).
+*/
+
+#ifndef O3_IO_BINARY_DOT_H
+#define O3_IO_BINARY_DOT_H
+
+#include <istream>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#include <type_traits>
+
+#include "triemap/triemap.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+// Compact binary format. The stream starts with a header followed by the nodes in depth first order. Every node starts
+// with a varint holding the number of children shifted left by one, with the lowest bit set when the node holds data.
+// The data follows, then the key and the node of every child. Integers are stored as varints, signed ones in zigzag
+// encoding, floating point numbers in little endian byte order.
+//----------------------------------------------------------------------------------------------------------------------
+
+namespace O3 {
+namespace io {
+namespace binary {
+
+// Malformed input. Offset is the position in the input where the problem was detected.
+class format_error : public std::runtime_error
+{
+    size_t m_offset;
+
+public:
+    format_error(const std::string& what, size_t offset)
+      : std::runtime_error(what + " at offset " + std::to_string(offset))
+      , m_offset(offset)
+    {}
+
+    [[nodiscard]] size_t offset() const
+    {
+        return m_offset;
+    }
+};
+
+// Output buffer that is flushed to the stream whenever it grows over the chunk size
+class encoder
+{
+    std::ostream* m_os = nullptr;
+    std::string   m_buf;
+    size_t        m_chunk = 0;
+
+public:
+    encoder() = default;
+
+    explicit encoder(std::ostream& os, size_t chunk = 1 << 16)
+      : m_os(&os)
+      , m_chunk(chunk)
+    {
+        m_buf.reserve(chunk + 16);
+    }
+
+    void put(uint8_t b)
+    {
+        m_buf += static_cast<char>(b);
+    }
+
+    void put(const void* p, size_t n)
+    {
+        m_buf.append(static_cast<const char*>(p), n);
+        if (m_os && m_buf.size() >= m_chunk) {
+            flush();
+        }
+    }
+
+    void varint(uint64_t v)
+    {
+        while (v >= 0x80) {
+            put(static_cast<uint8_t>(v | 0x80));
+            v >>= 7;
+        }
+        put(static_cast<uint8_t>(v));
+        if (m_os && m_buf.size() >= m_chunk) {
+            flush();
+        }
+    }
+
+    void flush()
+    {
+        if (m_os) {
+            m_os->write(m_buf.data(), static_cast<std::streamsize>(m_buf.size()));
+            m_buf.clear();
+        }
+    }
+
+    // Content of the buffer that was not flushed to the stream
+    [[nodiscard]] const std::string& str() const
+    {
+        return m_buf;
+    }
+};
+
+// Input buffer that reads the stream in fixed-size chunks
+class decoder
+{
+    std::istream*     m_is = nullptr;
+    std::vector<char> m_buf;
+    const char*       m_beg = nullptr;
+    const char*       m_cur = nullptr;
+    const char*       m_end = nullptr;
+    size_t            m_off = 0;
+
+    bool fill()
+    {
+        if (m_is == nullptr || !*m_is) {
+            return false;
+        }
+        m_off += m_end - m_beg;
+        m_is->read(m_buf.data(), static_cast<std::streamsize>(m_buf.size()));
+        m_beg = m_cur = m_buf.data();
+        m_end         = m_beg + m_is->gcount();
+        return m_cur != m_end;
+    }
+
+public:
+    explicit decoder(std::istream& is, size_t chunk = 1 << 16)
+      : m_is(&is)
+      , m_buf(chunk)
+    {}
+
+    explicit decoder(std::string_view sv)
+      : m_beg(sv.data())
+      , m_cur(sv.data())
+      , m_end(sv.data() + sv.size())
+    {}
+
+    [[noreturn]] void fail(const std::string& what) const
+    {
+        throw format_error(what, offset());
+    }
+
+    [[nodiscard]] size_t offset() const
+    {
+        return m_off + (m_cur - m_beg);
+    }
+
+    uint8_t get()
+    {
+        if (m_cur == m_end && !fill()) {
+            fail("Unexpected end of input");
+        }
+        return static_cast<uint8_t>(*m_cur++);
+    }
+
+    // Append n bytes to the string. Large lengths are read piecewise, so a corrupted length fails at the end of input
+    // instead of allocating.
+    void get(std::string& s, size_t n)
+    {
+        while (n > 0) {
+            if (m_cur == m_end && !fill()) {
+                fail("Unexpected end of input");
+            }
+            size_t len = std::min<size_t>(n, m_end - m_cur);
+            s.append(m_cur, len);
+            m_cur += len;
+            n -= len;
+        }
+    }
+
+    void get(void* p, size_t n)
+    {
+        auto* dst = static_cast<char*>(p);
+        while (n > 0) {
+            if (m_cur == m_end && !fill()) {
+                fail("Unexpected end of input");
+            }
+            size_t len = std::min<size_t>(n, m_end - m_cur);
+            std::memcpy(dst, m_cur, len);
+            m_cur += len;
+            dst += len;
+            n -= len;
+        }
+    }
+
+    uint64_t varint()
+    {
+        uint64_t v = 0;
+        for (unsigned shift = 0; shift < 64; shift += 7) {
+            uint8_t b = get();
+            v |= static_cast<uint64_t>(b & 0x7F) << shift;
+            if ((b & 0x80) == 0) {
+                return v;
+            }
+        }
+        fail("Varint too long");
+    }
+
+    // Return true if all input was consumed
+    bool done()
+    {
+        return m_cur == m_end && !fill();
+    }
+};
+
+// Prefix and data type traits. The default copies the object representation of trivially copyable types.
+template<typename T, typename = void>
+struct traits
+{
+    static_assert(std::is_trivially_copyable_v<T>, "Specialize O3::io::binary::traits for this type");
+
+    static inline void write(encoder& e, const T& t)
+    {
+        e.put(&t, sizeof(T));
+    }
+    static inline T read(decoder& d)
+    {
+        T t;
+        d.get(&t, sizeof(T));
+        return t;
+    }
+};
+
+// Integers and enumerations are stored as varints, signed ones zigzag encoded so small negative values stay short
+template<typename T>
+struct traits<T, std::enable_if_t<std::is_integral_v<T> || std::is_enum_v<T>>>
+{
+    using int_type = typename std::conditional_t<std::is_enum_v<T>, std::underlying_type<T>, std::common_type<T>>::type;
+
+    static inline void write(encoder& e, const T& t)
+    {
+        auto v = static_cast<int_type>(t);
+        if constexpr (std::is_signed_v<int_type>) {
+            auto u = static_cast<uint64_t>(static_cast<int64_t>(v));
+            e.varint((u << 1) ^ (v < 0 ? ~uint64_t(0) : 0));
+        } else {
+            e.varint(v);
+        }
+    }
+    static inline T read(decoder& d)
+    {
+        uint64_t u = d.varint();
+        if constexpr (std::is_signed_v<int_type>) {
+            return static_cast<T>(static_cast<int_type>(static_cast<int64_t>((u >> 1) ^ (~(u & 1) + 1))));
+        } else {
+            return static_cast<T>(static_cast<int_type>(u));
+        }
+    }
+};
+
+// Floating point numbers are stored in little endian byte order
+template<typename T>
+struct traits<T, std::enable_if_t<std::is_floating_point_v<T> && (sizeof(T) == 4 || sizeof(T) == 8)>>
+{
+    using bits_type = std::conditional_t<sizeof(T) == 4, uint32_t, uint64_t>;
+
+    static inline void write(encoder& e, const T& t)
+    {
+        bits_type bits;
+        std::memcpy(&bits, &t, sizeof(T));
+        uint8_t bytes[sizeof(T)];
+        for (size_t i = 0; i < sizeof(T); ++i) {
+            bytes[i] = static_cast<uint8_t>(bits >> (8 * i));
+        }
+        e.put(bytes, sizeof(T));
+    }
+    static inline T read(decoder& d)
+    {
+        uint8_t bytes[sizeof(T)];
+        d.get(bytes, sizeof(T));
+        bits_type bits = 0;
+        for (size_t i = 0; i < sizeof(T); ++i) {
+            bits |= static_cast<bits_type>(bytes[i]) << (8 * i);
+        }
+        T t;
+        std::memcpy(&t, &bits, sizeof(T));
+        return t;
+    }
+};
+
+// Single byte types do not need varints, their signedness differs between platforms
+template<>
+struct traits<char>
+{
+    static inline void write(encoder& e, char t)
+    {
+        e.put(static_cast<uint8_t>(t));
+    }
+    static inline char read(decoder& d)
+    {
+        return static_cast<char>(d.get());
+    }
+};
+
+template<>
+struct traits<bool>
+{
+    static inline void write(encoder& e, bool t)
+    {
+        e.put(t ? 1 : 0);
+    }
+    static inline bool read(decoder& d)
+    {
+        auto b = d.get();
+        if (b > 1) {
+            d.fail("Invalid boolean");
+        }
+        return b == 1;
+    }
+};
+
+// Strings are stored as varint length followed by the characters
+template<>
+struct traits<std::string>
+{
+    static inline void write(encoder& e, const std::string& t)
+    {
+        e.varint(t.size());
+        e.put(t.data(), t.size());
+    }
+    static inline std::string read(decoder& d)
+    {
+        std::string t;
+        d.get(t, d.varint());
+        return t;
+    }
+};
+
+namespace detail {
+
+template<typename N>
+void
+write_node(encoder& e, const N& n)
+{
+    e.varint(static_cast<uint64_t>(n.fanout()) << 1 | (n ? 1 : 0));
+    if (n) {
+        traits<typename N::data_type>::write(e, *n);
+    }
+    n.traverse_level([&](const auto& sn, const auto& sp) {
+        traits<std::decay_t<decltype(sp)>>::write(e, sp);
+        write_node(e, sn);
+        return true;
+    });
+}
+
+template<typename T, typename = void>
+struct has_children : std::false_type
+{};
+
+template<typename T>
+struct has_children<T, std::void_t<typename T::child_type>> : std::true_type
+{};
+
+// Largest number of children reserved up front. The count comes from the input, so a corrupted one must fail at the end
+// of input like a corrupted string length instead of allocating, larger nodes grow as their children are appended.
+constexpr uint64_t reserve_limit = 1 << 16;
+
+// Children arrive in the order of the saved trie-map, so ordered trie-maps are rebuilt with the append fast path
+template<typename N>
+void
+read_node(decoder& d, N& n)
+{
+    uint64_t head = d.varint();
+    if (head & 1) {
+        n.insert(traits<typename N::data_type>::read(d));
+    }
+
+    uint64_t fanout = head >> 1;
+    if constexpr (has_children<N>::value) {
+        n.reserve(std::min(fanout, reserve_limit));
+        for (; fanout > 0; --fanout) {
+            auto p = traits<typename N::prefix_type>::read(d);
+            read_node(d, n.append(std::move(p)));
+        }
+    } else if (fanout > 0) {
+        d.fail("Unexpected children at the last level");
+    }
+}
+
+template<typename T>
+struct levels;
+
+template<template<typename K, typename T> class MAP, typename POLICY, typename DATA, typename... PFIXS>
+struct levels<O3::collection::details::triemap<MAP, POLICY, DATA, PFIXS...>>
+  : std::integral_constant<size_t, sizeof...(PFIXS)>
+{};
+
+constexpr char magic[]   = { 'O', '3', 'T', 'M' };
+constexpr uint8_t version = 1;
+
+} // namespace detail
+
+// Nested trie-maps are stored as their node stream without a header
+template<template<typename K, typename T> class MAP, typename POLICY, typename DATA, typename... PFIXS>
+struct traits<O3::collection::details::triemap<MAP, POLICY, DATA, PFIXS...>>
+{
+    using type = O3::collection::details::triemap<MAP, POLICY, DATA, PFIXS...>;
+
+    static inline void write(encoder& e, const type& t)
+    {
+        detail::write_node(e, t);
+    }
+    static inline type read(decoder& d)
+    {
+        type t;
+        detail::read_node(d, t);
+        return t;
+    }
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+// Write trie-map with a header that records the format version and the number of levels
+//----------------------------------------------------------------------------------------------------------------------
+template<typename TM>
+void
+save(encoder& e, const TM& tm)
+{
+    e.put(detail::magic, sizeof(detail::magic));
+    e.put(detail::version);
+    e.varint(detail::levels<TM>::value);
+    detail::write_node(e, tm);
+    e.flush();
+}
+
+template<typename TM>
+void
+save(std::ostream& os, const TM& tm)
+{
+    encoder e(os);
+    save(e, tm);
+}
+
+template<typename TM>
+std::string
+save(const TM& tm)
+{
+    encoder e;
+    save(e, tm);
+    return e.str();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+// Replace content of the trie-map with the saved one. Throws format_error on malformed input and on input saved from a
+// trie-map with a different number of levels.
+//----------------------------------------------------------------------------------------------------------------------
+template<typename TM>
+void
+load(decoder& d, TM& tm)
+{
+    char magic[sizeof(detail::magic)];
+    d.get(magic, sizeof(magic));
+    if (std::memcmp(magic, detail::magic, sizeof(magic)) != 0) {
+        d.fail("Not a trie-map");
+    }
+    if (d.get() != detail::version) {
+        d.fail("Unsupported version");
+    }
+    if (d.varint() != detail::levels<TM>::value) {
+        d.fail("Number of levels does not match");
+    }
+
+    tm.clear();
+    detail::read_node(d, tm);
+}
+
+template<typename TM>
+void
+load(std::istream& is, TM& tm)
+{
+    decoder d(is);
+    load(d, tm);
+}
+
+template<typename TM>
+void
+load(std::string_view sv, TM& tm)
+{
+    decoder d(sv);
+    load(d, tm);
+    if (!d.done()) {
+        d.fail("Trailing data");
+    }
+}
+
+} // namespace binary
+} // namespace io
+} // namespace O3
+
+#endif
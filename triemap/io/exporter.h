@@ -0,0 +1,195 @@
+/*
+ Copyright (c) 2022, Slawomir Kuzniar.
+ Distributed under the MIT License (http://opensource.org/licenses/MIT).
+*/
+
+#ifndef O3_IO_EXPORTER_DOT_H
+#define O3_IO_EXPORTER_DOT_H
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <climits>
+#include <cerrno>
+#include <system_error>
+
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "triemap/triemap.h"
+#include "triemap/io/json.h"
+
+namespace O3 {
+namespace io {
+
+// Exporter results
+struct export_stats
+{
+    size_t bytes   = 0;
+    size_t writes  = 0;
+    double seconds = 0;
+
+    [[nodiscard]] double bytes_per_second() const
+    {
+        return seconds > 0 ? static_cast<double>(bytes) / seconds : 0;
+    }
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+// Export to a file descriptor in bounded memory. Output is formatted into fixed-size chunks, and whenever all chunks are
+// full they are written out with a single writev call. Memory use is the number of chunks times the chunk size plus the
+// size of one node, regardless of the size of the trie-map. The file descriptor is not closed.
+//----------------------------------------------------------------------------------------------------------------------
+class exporter
+{
+    int                      m_fd;
+    size_t                   m_chunk;
+    std::vector<std::string> m_chunks;
+    std::vector<iovec>       m_iov;
+    size_t                   m_used = 0;
+    export_stats             m_stats;
+
+public:
+    explicit exporter(int fd, size_t chunk = 1 << 16, size_t chunks = 16)
+      : m_fd(fd)
+      , m_chunk(chunk)
+      , m_chunks(std::max<size_t>(chunks, 1))
+      , m_iov(m_chunks.size())
+    {
+        for (auto& c : m_chunks) {
+            c.reserve(chunk);
+        }
+    }
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Export trie-map in one of the JSON formats
+    //------------------------------------------------------------------------------------------------------------------
+    template<typename TM>
+    export_stats json(const TM& tm, json::kind k = json::kind::proper, bool pretty = true)
+    {
+        return run([&](json::writer& w) { w.write(tm, k); }, pretty);
+    }
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Export trie-map as one line per data element. The line holds the prefixes followed by the data, each terminated by
+    // the separator except the data which is terminated by a new line. Prefixes and data are formatted the way the stream
+    // output operator would format them.
+    //------------------------------------------------------------------------------------------------------------------
+    template<typename TM>
+    export_stats lines(const TM& tm, char sep = '\t')
+    {
+        return run(
+            [&](json::writer& w) {
+                std::string         path;
+                std::vector<size_t> marks;
+                json::writer        key(false);
+
+                tm.traverse_dfs(
+                    [&](const auto& n, auto&&... qs) {
+                        w.spill();
+                        marks.push_back(path.size());
+                        if constexpr (sizeof...(qs) > 0) {
+                            (json::detail::emit(key, qs), ...);
+                            path += key.str();
+                            path += sep;
+                            key.clear();
+                        }
+                        if (n) {
+                            w.put(path);
+                            json::detail::emit(w, *n);
+                            w.put('\n');
+                        }
+                        return true;
+                    },
+                    [&](const auto&, auto&&...) {
+                        path.resize(marks.back());
+                        marks.pop_back();
+                        return true;
+                    });
+            },
+            false);
+    }
+
+    // Totals of all exports done by this exporter
+    [[nodiscard]] const export_stats& stats() const
+    {
+        return m_stats;
+    }
+
+private:
+    template<typename F>
+    export_stats run(F&& f, bool pretty)
+    {
+        export_stats st;
+        auto         start = std::chrono::steady_clock::now();
+
+        json::writer w(pretty);
+        w.reserve(m_chunk);
+        w.drain(m_chunk, [&](std::string& buf) {
+            st.bytes += buf.size();
+            buf.swap(m_chunks[m_used++]);
+            buf.clear();
+            if (m_used == m_chunks.size()) {
+                st.writes += write();
+            }
+        });
+
+        f(w);
+        w.flush();
+        st.writes += write();
+
+        st.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        m_stats.bytes += st.bytes;
+        m_stats.writes += st.writes;
+        m_stats.seconds += st.seconds;
+        return st;
+    }
+
+    // Write all full chunks, return number of system calls
+    size_t write()
+    {
+        for (size_t i = 0; i < m_used; ++i) {
+            m_iov[i].iov_base = m_chunks[i].data();
+            m_iov[i].iov_len  = m_chunks[i].size();
+        }
+
+        size_t calls = 0;
+        iovec* end   = m_iov.data() + m_used;
+        for (iovec* cur = m_iov.data(); cur != end;) {
+            if (cur->iov_len == 0) {
+                ++cur;
+                continue;
+            }
+            auto n = ::writev(m_fd, cur, static_cast<int>(std::min<size_t>(end - cur, IOV_MAX)));
+            ++calls;
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                m_used = 0;
+                throw std::system_error(errno, std::generic_category(), "writev");
+            }
+            // Skip fully written chunks and advance into a partially written one
+            for (auto left = static_cast<size_t>(n); left > 0; ++cur) {
+                if (left < cur->iov_len) {
+                    cur->iov_base = static_cast<char*>(cur->iov_base) + left;
+                    cur->iov_len -= left;
+                    break;
+                }
+                left -= cur->iov_len;
+            }
+        }
+
+        for (size_t i = 0; i < m_used; ++i) {
+            m_chunks[i].clear();
+        }
+        m_used = 0;
+        return calls;
+    }
+};
+
+} // namespace io
+} // namespace O3
+
+#endif
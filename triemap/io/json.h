@@ -7,9 +7,15 @@
 #define O3_IO_JSON_DOT_H
 
 #include <ostream>
+#include <sstream>
 #include <iomanip>
 #include <utility>
 #include <typeinfo>
+#include <string>
+#include <string_view>
+#include <charconv>
+#include <functional>
+#include <type_traits>
 
 #include "triemap/triemap.h"
 
@@ -129,6 +135,194 @@ fmt(std::basic_ostream<CharT, Traits>& os, kind k)
     os.iword(detail::fmtidx()) = static_cast<int>(k);
 }
 
+// Buffered writer. Output is appended into a growable buffer, numbers are formatted with std::to_chars and indentation
+// is copied from a precomputed run of spaces. In pretty mode the output is identical to the stream manipulators, compact
+// mode leaves out new lines and indentation. Values are formatted as if written to a stream with default flags.
+class writer
+{
+    std::string m_buf;
+    int         m_indent = 0;
+    bool        m_pretty = true;
+    kind        m_kind   = kind::like;
+    size_t      m_chunk  = 0;
+
+    std::function<void(std::string&)> m_drain;
+
+public:
+    explicit writer(bool pretty = true)
+      : m_pretty(pretty)
+    {}
+
+    // Write triemap collection in the given format
+    template<typename TM>
+    writer& write(const TM& tm, kind k = kind::like);
+
+    [[nodiscard]] const std::string& str() const
+    {
+        return m_buf;
+    }
+
+    [[nodiscard]] size_t size() const
+    {
+        return m_buf.size();
+    }
+
+    [[nodiscard]] kind format() const
+    {
+        return m_kind;
+    }
+
+    [[nodiscard]] bool pretty() const
+    {
+        return m_pretty;
+    }
+
+    void clear()
+    {
+        m_buf.clear();
+        m_indent = 0;
+    }
+
+    void reserve(size_t n)
+    {
+        m_buf.reserve(n);
+    }
+
+    // Hand the buffer over to the drain function whenever it grows over the chunk size. The drain consumes the content
+    // and may swap in another buffer. Output is checked at node boundaries, so the buffer can exceed the chunk size by
+    // the size of one node.
+    template<typename F>
+    void drain(size_t chunk, F&& f)
+    {
+        m_chunk = chunk;
+        m_drain = std::forward<F>(f);
+    }
+
+    void spill()
+    {
+        if (m_drain && m_buf.size() >= m_chunk) {
+            m_drain(m_buf);
+        }
+    }
+
+    // Hand whatever is left in the buffer over to the drain function
+    void flush()
+    {
+        if (m_drain && !m_buf.empty()) {
+            m_drain(m_buf);
+        }
+    }
+
+    void put(char c)
+    {
+        m_buf.push_back(c);
+    }
+
+    void put(std::string_view s)
+    {
+        m_buf.append(s);
+    }
+
+    // Output string with enclosing quotes
+    void quoted(std::string_view s)
+    {
+        put('"');
+        put(s);
+        put('"');
+    }
+
+    template<typename T>
+    void number(T t)
+    {
+        char                 buf[64];
+        std::to_chars_result rv;
+        if constexpr (std::is_floating_point_v<T>) {
+            rv = std::to_chars(buf, buf + sizeof(buf), t, std::chars_format::general, 6);
+        } else {
+            rv = std::to_chars(buf, buf + sizeof(buf), t);
+        }
+        m_buf.append(buf, rv.ptr);
+    }
+
+    // Output new line, then output indentation
+    void ind()
+    {
+        static constexpr std::string_view spaces = "                                                                ";
+        if (m_pretty) {
+            put('\n');
+            for (int i = m_indent; i > 0; i -= static_cast<int>(spaces.size())) {
+                put(spaces.substr(0, std::min<size_t>(i, spaces.size())));
+            }
+        }
+    }
+
+    // Output new line, then increase and output indentation
+    void inc()
+    {
+        m_indent += 2;
+        ind();
+    }
+
+    // Output new line, then decrease and output indentation
+    void dec()
+    {
+        m_indent -= 2;
+        ind();
+    }
+
+    // Conditionally output comma followed by new line and indentation, then reset flag to false
+    void cif(bool& flag)
+    {
+        if (flag) {
+            cin();
+        }
+        flag = false;
+    }
+
+    // Unconditionally output comma followed by new line and indentation
+    void cin()
+    {
+        put(',');
+        ind();
+    }
+};
+
+namespace detail {
+
+// Format value through a stream. This is the slow path for types the writer does not know about.
+template<typename F>
+void
+format(writer& w, F&& f)
+{
+    thread_local std::ostringstream os;
+    os.str(std::string());
+    os.clear();
+    fmt(os, w.format());
+    f(os);
+    w.put(os.str());
+}
+
+// Output element the way stream output operator would
+template<typename E>
+void
+emit(writer& w, const E& e)
+{
+    if constexpr (std::is_same_v<E, bool>) {
+        w.put(e ? '1' : '0');
+    } else if constexpr (std::is_same_v<E, char> || std::is_same_v<E, signed char> ||
+                         std::is_same_v<E, unsigned char>) {
+        w.put(static_cast<char>(e));
+    } else if constexpr (std::is_arithmetic_v<E>) {
+        w.number(e);
+    } else if constexpr (std::is_convertible_v<const E&, std::string_view>) {
+        w.put(std::string_view(e));
+    } else {
+        format(w, [&](auto& os) { os << e; });
+    }
+}
+
+} // namespace detail
+
 namespace detail {
 
 // Print element with enclosing quotes
@@ -174,6 +368,10 @@ struct traits
     {
         os << t;
     }
+    static inline void write(writer& w, const T& t)
+    {
+        detail::emit(w, t);
+    }
     static inline const char* dtag()
     {
         return "data";
@@ -189,6 +387,10 @@ struct traits<std::string>
     {
         os << quoted(t);
     }
+    static inline void write(writer& w, const std::string& t)
+    {
+        w.quoted(t);
+    }
     static inline const char* dtag()
     {
         return "data";
@@ -203,6 +405,10 @@ struct traits<char>
     {
         os << quoted(t);
     }
+    static inline void write(writer& w, char t)
+    {
+        w.quoted(std::string_view(&t, 1));
+    }
     static inline const char* dtag()
     {
         return "data";
@@ -217,6 +423,10 @@ struct traits<const char*>
     {
         os << quoted(t);
     }
+    static inline void write(writer& w, const char* t)
+    {
+        w.quoted(t);
+    }
     static inline const char* dtag()
     {
         return "data";
@@ -246,6 +456,10 @@ struct traits<bool>
     {
         os << (t ? "true" : "false");
     }
+    static inline void write(writer& w, bool t)
+    {
+        w.put(t ? "true" : "false");
+    }
     static inline const char* dtag()
     {
         return "data";
@@ -459,13 +673,13 @@ d3(const TM& tm)
     return detail::json_d3<TM>(tm);
 }
 
-// Data type traits specialization for ordered and unordered triemap
-template<typename DATA, typename PFIX, typename... PFIXS>
-struct traits<O3::collection::otriemap<DATA, PFIX, PFIXS...>>
+// Data type traits specialization for triemap collections
+template<template<typename K, typename T> class MAP, typename POLICY, typename DATA, typename PFIX, typename... PFIXS>
+struct traits<O3::collection::details::triemap<MAP, POLICY, DATA, PFIX, PFIXS...>>
 {
     template<class CharT, class Traits>
-    static inline void print(std::basic_ostream<CharT, Traits>&                    os,
-                             const O3::collection::otriemap<DATA, PFIX, PFIXS...>& t)
+    static inline void print(std::basic_ostream<CharT, Traits>&                                         os,
+                             const O3::collection::details::triemap<MAP, POLICY, DATA, PFIX, PFIXS...>& t)
     {
         switch (fmt(os)) {
             case kind::like:
@@ -479,53 +693,242 @@ struct traits<O3::collection::otriemap<DATA, PFIX, PFIXS...>>
                 break;
         };
     }
+    static inline void write(writer& w, const O3::collection::details::triemap<MAP, POLICY, DATA, PFIX, PFIXS...>& t)
+    {
+        w.write(t, w.format());
+    }
     static inline const char* dtag()
     {
         return "data";
     }
 };
 
-template<typename DATA, typename PFIX, typename... PFIXS>
-struct traits<O3::collection::utriemap<DATA, PFIX, PFIXS...>>
+namespace detail {
+
+// Write data element using traits, falling back to traits print for types that do not provide write
+template<typename T, typename = void>
+struct has_write : std::false_type
+{};
+
+template<typename T>
+struct has_write<T, std::void_t<decltype(traits<T>::write(std::declval<writer&>(), std::declval<const T&>()))>>
+  : std::true_type
+{};
+
+template<typename T>
+void
+value(writer& w, const T& t)
 {
-    template<class CharT, class Traits>
-    static inline void print(std::basic_ostream<CharT, Traits>&                    os,
-                             const O3::collection::utriemap<DATA, PFIX, PFIXS...>& t)
-    {
-        switch (fmt(os)) {
-            case kind::like:
-                os << like(t);
-                break;
-            case kind::proper:
-                os << proper(t);
-                break;
-            case kind::d3:
-                os << d3(t);
-                break;
-        };
+    if constexpr (has_write<T>::value) {
+        traits<T>::write(w, t);
+    } else {
+        format(w, [&](auto& os) { traits<T>::print(os, t); });
     }
-    static inline const char* dtag()
-    {
-        return "data";
+}
+
+// Type name is looked up once per prefix type
+template<typename P>
+std::string_view
+type_name()
+{
+    static const std::string_view name = typeid(P).name();
+    return name;
+}
+
+// Write triemap collection as a JSON-like object
+template<typename TM>
+void
+write_like(writer& w, const TM& tm)
+{
+    using data = typename TM::data_type;
+
+    bool comma = false;
+
+    tm.traverse_dfs(
+        [&](const auto& n, auto&&... qs) {
+            w.spill();
+            w.cif(comma);
+            if constexpr (sizeof...(qs) > 0) {
+                (emit(w, qs), ...);
+                w.put(':');
+            }
+
+            w.put('{');
+            w.inc();
+
+            if (n) {
+                w.put(traits<data>::dtag());
+                w.put(':');
+                value(w, *n);
+                comma = true;
+            } else {
+                comma = false;
+            }
+
+            return true;
+        },
+        [&](const auto&, auto&&...) {
+            w.dec();
+            w.put('}');
+            comma = true;
+            return true;
+        });
+}
+
+// Write triemap collection as a proper JSON object
+template<typename TM>
+void
+write_proper(writer& w, const TM& tm)
+{
+    using data = typename TM::data_type;
+
+    bool comma = false;
+
+    tm.traverse_dfs(
+        [&](const auto& n, auto&&... qs) {
+            w.spill();
+            w.cif(comma);
+            if constexpr (sizeof...(qs) > 0) {
+                w.put('"');
+                (emit(w, qs), ...);
+                w.put('"');
+                w.put(':');
+            }
+
+            w.put('{');
+            w.inc();
+
+            if (n) {
+                w.quoted(traits<data>::dtag());
+                w.put(':');
+                value(w, *n);
+                comma = true;
+            } else {
+                comma = false;
+            }
+
+            return true;
+        },
+        [&](const auto&, auto&&...) {
+            w.dec();
+            w.put('}');
+            comma = true;
+            return true;
+        });
+}
+
+// Write data and children of a node in D3 format
+template<typename TM, typename Node>
+void
+write_d3_body(writer& w, const Node& n, bool& comma);
+
+template<typename TM, typename Node, typename Prefix>
+void
+write_d3(writer& w, const Node& n, const Prefix& p, bool first)
+{
+    bool comma = !first;
+
+    w.spill();
+    w.cif(comma);
+    w.put('{');
+    w.inc();
+    w.quoted("type");
+    w.put(':');
+    w.quoted(type_name<Prefix>());
+    w.cin();
+    w.quoted("name");
+    w.put(':');
+    w.put('"');
+    emit(w, p);
+    w.put('"');
+    comma = true;
+
+    write_d3_body<TM>(w, n, comma);
+}
+
+template<typename TM, typename Node>
+void
+write_d3_body(writer& w, const Node& n, bool& comma)
+{
+    if (n) {
+        w.cif(comma);
+        w.quoted(traits<typename TM::data_type>::dtag());
+        w.put(':');
+        value(w, *n);
+        comma = !n.leaf();
     }
-};
 
-} // namespace json
-} // namespace io
-} // namespace O3
+    if (!n.leaf()) {
+        w.cif(comma);
+        w.quoted("children");
+        w.put(':');
+        w.put('[');
+        w.ind();
+
+        bool first = true;
+        n.traverse_level([&](const auto& sn, const auto& sp) {
+            write_d3<TM>(w, sn, sp, first);
+            first = false;
+            return true;
+        });
+        w.ind();
+        w.put(']');
+    }
+    w.dec();
+    w.put('}');
+}
 
-// Ordered and unordered triemap output operator
-template<typename CharT, typename Traits, typename DATA, typename PFIX, typename... PFIXS>
-inline std::basic_ostream<CharT, Traits>&
-operator<<(std::basic_ostream<CharT, Traits>& os, const O3::collection::otriemap<DATA, PFIX, PFIXS...>& t)
+// Write triemap collection as a proper JSON object suitable for D3 visualization
+template<typename TM>
+void
+write_d3(writer& w, const TM& tm)
 {
-    os << O3::io::json::like(t);
-    return os;
+    w.put('{');
+    w.inc();
+
+    bool comma = false;
+    write_d3_body<TM>(w, tm, comma);
+}
+
+} // namespace detail
+
+template<typename TM>
+writer&
+writer::write(const TM& tm, kind k)
+{
+    kind outer = m_kind;
+    m_kind     = k;
+    switch (k) {
+        case kind::like:
+            detail::write_like(*this, tm);
+            break;
+        case kind::proper:
+            detail::write_proper(*this, tm);
+            break;
+        case kind::d3:
+            detail::write_d3(*this, tm);
+            break;
+    }
+    m_kind = outer;
+    return *this;
 }
 
-template<typename CharT, typename Traits, typename DATA, typename PFIX, typename... PFIXS>
+} // namespace json
+} // namespace io
+} // namespace O3
+
+// Triemap collection output operator
+template<typename CharT,
+         typename Traits,
+         template<typename K, typename T>
+         class MAP,
+         typename POLICY,
+         typename DATA,
+         typename PFIX,
+         typename... PFIXS>
 inline std::basic_ostream<CharT, Traits>&
-operator<<(std::basic_ostream<CharT, Traits>& os, const O3::collection::utriemap<DATA, PFIX, PFIXS...>& t)
+operator<<(std::basic_ostream<CharT, Traits>&                                         os,
+           const O3::collection::details::triemap<MAP, POLICY, DATA, PFIX, PFIXS...>& t)
 {
     os << O3::io::json::like(t);
     return os;
@@ -0,0 +1,568 @@
+/*
+ Copyright (c) 2022, Slawomir Kuzniar.
+ Distributed under the MIT License (http://opensource.org/licenses/MIT).
+*/
+
+#ifndef O3_IO_JSON_READER_DOT_H
+#define O3_IO_JSON_READER_DOT_H
+
+#include <istream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <charconv>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "triemap/triemap.h"
+#include "triemap/io/json.h"
+
+namespace O3 {
+namespace io {
+namespace json {
+
+// Malformed input. Offset is the position in the input where the problem was detected.
+class parse_error : public std::runtime_error
+{
+    size_t m_offset;
+
+public:
+    parse_error(const std::string& what, size_t offset)
+      : std::runtime_error(what + " at offset " + std::to_string(offset))
+      , m_offset(offset)
+    {}
+
+    [[nodiscard]] size_t offset() const
+    {
+        return m_offset;
+    }
+};
+
+// Conversion of JSON text into prefix and data types. Strings are passed without quotes and with escapes resolved,
+// numbers and literals are passed as they appear in the input.
+template<typename T>
+struct parse_traits
+{
+    static inline T parse(std::string_view text)
+    {
+        if constexpr (std::is_arithmetic_v<T>) {
+            T    t{};
+            auto rv = std::from_chars(text.data(), text.data() + text.size(), t);
+            if (rv.ec != std::errc() || rv.ptr != text.data() + text.size()) {
+                throw std::invalid_argument("Invalid number: " + std::string(text));
+            }
+            return t;
+        } else if constexpr (std::is_constructible_v<T, std::string>) {
+            return T(std::string(text));
+        } else {
+            std::istringstream is{ std::string(text) };
+            T                  t;
+            is >> t;
+            return t;
+        }
+    }
+};
+
+// Parse traits specialization for single characters
+template<>
+struct parse_traits<char>
+{
+    static inline char parse(std::string_view text)
+    {
+        if (text.size() != 1) {
+            throw std::invalid_argument("Invalid character: " + std::string(text));
+        }
+        return text[0];
+    }
+};
+
+// Parse traits specialization for bool, accepting the literals and the numbers written for boolean prefixes
+template<>
+struct parse_traits<bool>
+{
+    static inline bool parse(std::string_view text)
+    {
+        if (text == "true" || text == "1") {
+            return true;
+        }
+        if (text == "false" || text == "0") {
+            return false;
+        }
+        throw std::invalid_argument("Invalid boolean: " + std::string(text));
+    }
+};
+
+namespace detail {
+
+template<typename T>
+struct is_triemap : std::false_type
+{};
+
+template<template<typename K, typename T> class MAP, typename POLICY, typename DATA, typename... PFIXS>
+struct is_triemap<O3::collection::details::triemap<MAP, POLICY, DATA, PFIXS...>> : std::true_type
+{};
+
+template<typename T, typename = void>
+struct has_children : std::false_type
+{};
+
+template<typename T>
+struct has_children<T, std::void_t<typename T::child_type>> : std::true_type
+{};
+
+// Tokenizer that reads the input in fixed-size chunks and never holds more than one chunk and one token
+class scanner
+{
+    std::istream*     m_is = nullptr;
+    std::vector<char> m_buf;
+    const char*       m_beg = nullptr;
+    const char*       m_cur = nullptr;
+    const char*       m_end = nullptr;
+    size_t            m_off = 0;
+    std::string       m_text;
+
+    bool fill()
+    {
+        if (m_is == nullptr || !*m_is) {
+            return false;
+        }
+        m_off += m_end - m_beg;
+        m_is->read(m_buf.data(), static_cast<std::streamsize>(m_buf.size()));
+        m_beg = m_cur = m_buf.data();
+        m_end         = m_beg + m_is->gcount();
+        return m_cur != m_end;
+    }
+
+    int get()
+    {
+        if (m_cur == m_end && !fill()) {
+            return EOF;
+        }
+        return static_cast<unsigned char>(*m_cur++);
+    }
+
+    static bool space(char c)
+    {
+        return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+    }
+
+    static bool delimiter(char c)
+    {
+        return space(c) || c == ',' || c == ':' || c == '}' || c == ']';
+    }
+
+    unsigned hex()
+    {
+        unsigned v = 0;
+        for (int i = 0; i < 4; ++i) {
+            int c = get();
+            v <<= 4;
+            if (c >= '0' && c <= '9') {
+                v |= c - '0';
+            } else if (c >= 'a' && c <= 'f') {
+                v |= c - 'a' + 10;
+            } else if (c >= 'A' && c <= 'F') {
+                v |= c - 'A' + 10;
+            } else {
+                fail("Invalid unicode escape");
+            }
+        }
+        return v;
+    }
+
+    void utf8(unsigned cp)
+    {
+        if (cp < 0x80) {
+            m_text += static_cast<char>(cp);
+        } else if (cp < 0x800) {
+            m_text += static_cast<char>(0xC0 | (cp >> 6));
+            m_text += static_cast<char>(0x80 | (cp & 0x3F));
+        } else if (cp < 0x10000) {
+            m_text += static_cast<char>(0xE0 | (cp >> 12));
+            m_text += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            m_text += static_cast<char>(0x80 | (cp & 0x3F));
+        } else {
+            m_text += static_cast<char>(0xF0 | (cp >> 18));
+            m_text += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+            m_text += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            m_text += static_cast<char>(0x80 | (cp & 0x3F));
+        }
+    }
+
+    void escape()
+    {
+        int c = get();
+        switch (c) {
+            case '"':
+            case '\\':
+            case '/':
+                m_text += static_cast<char>(c);
+                break;
+            case 'b':
+                m_text += '\b';
+                break;
+            case 'f':
+                m_text += '\f';
+                break;
+            case 'n':
+                m_text += '\n';
+                break;
+            case 'r':
+                m_text += '\r';
+                break;
+            case 't':
+                m_text += '\t';
+                break;
+            case 'u': {
+                unsigned cp = hex();
+                if (cp >= 0xD800 && cp < 0xDC00) {
+                    if (get() != '\\' || get() != 'u') {
+                        fail("Unpaired surrogate");
+                    }
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (hex() - 0xDC00);
+                }
+                utf8(cp);
+                break;
+            }
+            default:
+                fail("Invalid escape");
+        }
+    }
+
+public:
+    explicit scanner(std::istream& is, size_t chunk = 1 << 16)
+      : m_is(&is)
+      , m_buf(chunk)
+    {}
+
+    explicit scanner(std::string_view sv)
+      : m_beg(sv.data())
+      , m_cur(sv.data())
+      , m_end(sv.data() + sv.size())
+    {}
+
+    [[noreturn]] void fail(const std::string& what) const
+    {
+        throw parse_error(what, m_off + (m_cur - m_beg));
+    }
+
+    // Return next significant character without consuming it
+    int peek()
+    {
+        for (;;) {
+            while (m_cur != m_end) {
+                if (!space(*m_cur)) {
+                    return static_cast<unsigned char>(*m_cur);
+                }
+                ++m_cur;
+            }
+            if (!fill()) {
+                return EOF;
+            }
+        }
+    }
+
+    // Consume next significant character if it matches
+    bool accept(char c)
+    {
+        if (peek() == c) {
+            ++m_cur;
+            return true;
+        }
+        return false;
+    }
+
+    void expect(char c)
+    {
+        if (!accept(c)) {
+            fail(std::string("Expected '") + c + '\'');
+        }
+    }
+
+    // Read quoted string. The result is valid until the next token is read.
+    std::string_view string()
+    {
+        expect('"');
+        m_text.clear();
+        for (;;) {
+            const char* run = m_cur;
+            while (m_cur != m_end && *m_cur != '"' && *m_cur != '\\') {
+                ++m_cur;
+            }
+            m_text.append(run, m_cur);
+
+            int c = get();
+            if (c == '"') {
+                return m_text;
+            }
+            if (c == '\\') {
+                escape();
+            } else if (c == EOF) {
+                fail("Unterminated string");
+            } else {
+                --m_cur;
+            }
+        }
+    }
+
+    // Read string, number or literal. The result is valid until the next token is read.
+    std::string_view token()
+    {
+        if (peek() == '"') {
+            return string();
+        }
+        m_text.clear();
+        for (;;) {
+            const char* run = m_cur;
+            while (m_cur != m_end && !delimiter(*m_cur)) {
+                ++m_cur;
+            }
+            m_text.append(run, m_cur);
+            if (m_cur != m_end || !fill()) {
+                break;
+            }
+        }
+        if (m_text.empty()) {
+            fail("Expected value");
+        }
+        return m_text;
+    }
+
+    // Skip any value, including nested objects and arrays
+    void skip()
+    {
+        int c = peek();
+        if (c != '{' && c != '[') {
+            token();
+            return;
+        }
+        ++m_cur;
+        for (size_t depth = 1; depth > 0;) {
+            c = peek();
+            if (c == '"') {
+                string();
+                continue;
+            }
+            if (c == EOF) {
+                fail("Unexpected end of input");
+            }
+            ++m_cur;
+            if (c == '{' || c == '[') {
+                ++depth;
+            } else if (c == '}' || c == ']') {
+                --depth;
+            }
+        }
+    }
+};
+
+// Recursive descent parser that inserts elements into the trie-map as soon as they are read
+class parser
+{
+    scanner& m_in;
+    kind     m_kind;
+
+    template<typename Node>
+    void data(Node& n)
+    {
+        using D = typename Node::data_type;
+        if constexpr (is_triemap<D>::value) {
+            D d;
+            root(d);
+            n.insert(std::move(d));
+        } else {
+            if (m_in.peek() == 'n') {
+                if (m_in.token() != "null") {
+                    m_in.fail("Invalid literal");
+                }
+                return;
+            }
+            auto text = m_in.token();
+            try {
+                n.insert(parse_traits<D>::parse(text));
+            } catch (const std::invalid_argument& e) {
+                m_in.fail(e.what());
+            }
+        }
+    }
+
+    template<typename Node>
+    typename Node::prefix_type prefix(std::string_view text)
+    {
+        try {
+            return parse_traits<typename Node::prefix_type>::parse(text);
+        } catch (const std::invalid_argument& e) {
+            m_in.fail(e.what());
+        }
+    }
+
+    // Children are created as soon as their key is read, and removed again if no data was found beneath them
+    template<typename Node>
+    void prune(Node& n, const typename Node::prefix_type& p)
+    {
+        bool vacant = false;
+        std::as_const(n).jump([&](const auto& c) { vacant = c.empty(); }, p);
+        if (vacant) {
+            n.erase(p);
+        }
+    }
+
+    // Proper format object. Keys other than the data tag are children.
+    template<typename Node>
+    void proper(Node& n)
+    {
+        m_in.expect('{');
+        if (m_in.accept('}')) {
+            return;
+        }
+        do {
+            auto key = m_in.string();
+            m_in.expect(':');
+            if (key == traits<typename Node::data_type>::dtag()) {
+                data(n);
+            } else if constexpr (has_children<Node>::value) {
+                auto p = prefix<Node>(key);
+                proper(n.child(p));
+                prune(n, p);
+            } else {
+                m_in.fail("Unexpected key in leaf node");
+            }
+        } while (m_in.accept(','));
+        m_in.expect('}');
+    }
+
+    // D3 format children array
+    template<typename Node>
+    void children(Node& n)
+    {
+        m_in.expect('[');
+        if (m_in.accept(']')) {
+            return;
+        }
+        do {
+            if constexpr (has_children<Node>::value) {
+                d3(n);
+            } else {
+                m_in.fail("Unexpected children in leaf node");
+            }
+        } while (m_in.accept(','));
+        m_in.expect(']');
+    }
+
+    // D3 format node. Name must come before data and children, as written by the d3 printer.
+    template<typename Node>
+    void d3(Node& parent)
+    {
+        typename Node::child_type*                n = nullptr;
+        std::optional<typename Node::prefix_type> p;
+
+        m_in.expect('{');
+        if (!m_in.accept('}')) {
+            do {
+                auto key = m_in.string();
+                m_in.expect(':');
+                if (key == "name") {
+                    p = prefix<Node>(m_in.token());
+                    n = &parent.child(*p);
+                } else if (key == traits<typename Node::data_type>::dtag() || key == "children") {
+                    if (n == nullptr) {
+                        m_in.fail("Node name must precede its data and children");
+                    }
+                    if (key == "children") {
+                        children(*n);
+                    } else {
+                        data(*n);
+                    }
+                } else {
+                    m_in.skip();
+                }
+            } while (m_in.accept(','));
+            m_in.expect('}');
+        }
+        if (n == nullptr) {
+            m_in.fail("Node without name");
+        }
+        prune(parent, *p);
+    }
+
+    // D3 format root has no name
+    template<typename Node>
+    void d3_root(Node& n)
+    {
+        m_in.expect('{');
+        if (m_in.accept('}')) {
+            return;
+        }
+        do {
+            auto key = m_in.string();
+            m_in.expect(':');
+            if (key == traits<typename Node::data_type>::dtag()) {
+                data(n);
+            } else if (key == "children") {
+                children(n);
+            } else {
+                m_in.skip();
+            }
+        } while (m_in.accept(','));
+        m_in.expect('}');
+    }
+
+public:
+    parser(scanner& in, kind k)
+      : m_in(in)
+      , m_kind(k)
+    {
+        if (k != kind::proper && k != kind::d3) {
+            in.fail("Only proper and d3 formats can be read");
+        }
+    }
+
+    template<typename TM>
+    void root(TM& tm)
+    {
+        if (m_kind == kind::d3) {
+            d3_root(tm);
+        } else {
+            proper(tm);
+        }
+    }
+};
+
+template<typename TM>
+void
+read(scanner& in, TM& tm, kind k)
+{
+    parser(in, k).root(tm);
+    if (in.peek() != EOF) {
+        in.fail("Unexpected trailing input");
+    }
+}
+
+} // namespace detail
+
+// Read triemap collection written in proper or d3 format. Elements are added to the collection while the input is
+// parsed, without building an intermediate document. Throws parse_error on malformed input.
+template<typename TM>
+void
+read(std::istream& is, TM& tm, kind k = kind::proper)
+{
+    detail::scanner in(is);
+    detail::read(in, tm, k);
+}
+
+template<typename TM>
+void
+read(std::string_view sv, TM& tm, kind k = kind::proper)
+{
+    detail::scanner in(sv);
+    detail::read(in, tm, k);
+}
+
+} // namespace json
+} // namespace io
+} // namespace O3
+
+#endif
@@ -0,0 +1,389 @@
+/*
+ Copyright (c) 2022, Slawomir Kuzniar.
+ Distributed under the MIT License (http://opensource.org/licenses/MIT).
+*/
+
+#ifndef O3_COLLECTION_PRODUCT_DOT_H
+#define O3_COLLECTION_PRODUCT_DOT_H
+
+#include <array>
+#include <tuple>
+#include <optional>
+#include <utility>
+#include <type_traits>
+
+#include "triemap/triemap.h"
+
+namespace O3::collection {
+
+// Candidate of a two-dimensional match, number of outer and inner prefixes it uses
+struct match_depths
+{
+    size_t outer;
+    size_t inner;
+};
+
+// Precedence of candidates where the longer outer path wins, then the longer inner path
+struct outer_first
+{
+    bool operator()(const match_depths& x, const match_depths& y) const
+    {
+        return x.outer != y.outer ? x.outer > y.outer : x.inner > y.inner;
+    }
+};
+
+// Precedence of candidates where the longer inner path wins, then the longer outer path
+struct inner_first
+{
+    bool operator()(const match_depths& x, const match_depths& y) const
+    {
+        return x.inner != y.inner ? x.inner > y.inner : x.outer > y.outer;
+    }
+};
+
+// Precedence of candidates where more prefixes in total win, ties go to the longer outer path
+struct most_specific
+{
+    bool operator()(const match_depths& x, const match_depths& y) const
+    {
+        auto a = x.outer + x.inner;
+        auto b = y.outer + y.inner;
+        return a != b ? a > b : x.outer > y.outer;
+    }
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+// Trie-map over the product of two hierarchies, such as geography and organization. It replaces a trie-map keyed by the
+// outer prefixes whose data are trie-maps keyed by the inner prefixes, and stores both in one trie-map. Outer levels are
+// keyed by optional prefixes, and an outer path shorter than the outer levels is padded with empty ones, so every
+// element lives at the outer levels followed by its inner path. Paths are given as tuples of prefixes, each as long as
+// its hierarchy or shorter, and lookups in both hierarchies are a single descent.
+//----------------------------------------------------------------------------------------------------------------------
+template<template<typename K, typename T> class MAP, typename POLICY, typename DATA, typename OUTER, typename INNER>
+class product;
+
+template<template<typename K, typename T> class MAP, typename POLICY, typename DATA, typename... OS, typename... IS>
+class product<MAP, POLICY, DATA, std::tuple<OS...>, std::tuple<IS...>>
+{
+public:
+    using trie_type  = details::triemap<MAP,
+                                       typename details::policy_for<POLICY, sizeof...(OS) + sizeof...(IS)>::type,
+                                       DATA,
+                                       std::optional<OS>...,
+                                       IS...>;
+    using data_type  = DATA;
+    using outer_type = std::tuple<OS...>;
+    using inner_type = std::tuple<IS...>;
+
+    static constexpr size_t outer_levels = sizeof...(OS);
+    static constexpr size_t inner_levels = sizeof...(IS);
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Underlying trie-map for traversal and statistics
+    //------------------------------------------------------------------------------------------------------------------
+    const trie_type& trie() const
+    {
+        return m_tm;
+    }
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Insert or return existing data given the outer and inner paths
+    //------------------------------------------------------------------------------------------------------------------
+    template<class D, typename... PS, typename... QS>
+    std::pair<DATA*, bool> insert(D&& data, const std::tuple<PS...>& outer, const std::tuple<QS...>& inner)
+    {
+        static_assert(sizeof...(PS) <= outer_levels && sizeof...(QS) <= inner_levels, "Too many prefixes");
+        return insert_at(std::forward<D>(data),
+                         outer,
+                         inner,
+                         std::make_index_sequence<outer_levels>(),
+                         std::make_index_sequence<sizeof...(QS)>());
+    }
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Erase data given the outer and inner paths
+    //------------------------------------------------------------------------------------------------------------------
+    template<typename... PS, typename... QS>
+    size_t erase(const std::tuple<PS...>& outer, const std::tuple<QS...>& inner)
+    {
+        return call([&](const auto&... ks) { return m_tm.erase(ks...); }, outer, inner);
+    }
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Find the data given the outer and inner paths
+    //------------------------------------------------------------------------------------------------------------------
+    template<typename... PS, typename... QS>
+    const DATA* find(const std::tuple<PS...>& outer, const std::tuple<QS...>& inner) const
+    {
+        return call([&](const auto&... ks) { return m_tm.find(ks...); }, outer, inner);
+    }
+
+    template<typename... PS, typename... QS>
+    DATA* find(const std::tuple<PS...>& outer, const std::tuple<QS...>& inner)
+    {
+        return call([&](const auto&... ks) { return m_tm.find(ks...); }, outer, inner);
+    }
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Find the most specific data along both paths. Candidates are pairs of outer and inner path lengths, tried in the
+    // order given by the precedence until one holds data. By default the longest outer path with any match along the
+    // inner path wins, and within it the longest inner path. Nodes are looked up on first use and kept for the next
+    // candidates, so every node is looked up at most once.
+    //------------------------------------------------------------------------------------------------------------------
+    template<typename... PS, typename... QS, typename PRECEDENCE = outer_first>
+    const DATA* match(const std::tuple<PS...>& outer,
+                      const std::tuple<QS...>& inner,
+                      PRECEDENCE&&             precedence = PRECEDENCE()) const
+    {
+        return match_in(m_tm, outer, inner, precedence);
+    }
+
+    template<typename... PS, typename... QS, typename PRECEDENCE = outer_first>
+    DATA* match(const std::tuple<PS...>& outer, const std::tuple<QS...>& inner, PRECEDENCE&& precedence = PRECEDENCE())
+    {
+        return match_in(m_tm, outer, inner, precedence);
+    }
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Clear all data
+    //------------------------------------------------------------------------------------------------------------------
+    void clear()
+    {
+        m_tm.clear();
+    }
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Return number of data elements
+    //------------------------------------------------------------------------------------------------------------------
+    [[nodiscard]] size_t size() const
+    {
+        return m_tm.size();
+    }
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Equality
+    //------------------------------------------------------------------------------------------------------------------
+    bool operator==(const product& oth) const
+    {
+        return m_tm == oth.m_tm;
+    }
+
+private:
+    // Ordered containers compare optional keys with plain prefixes, unordered ones hash the key type only
+    static constexpr bool sorted = details::is_sorted<typename trie_type::repo_type>::value;
+
+    // Outer key at level J for inserting
+    template<size_t J, typename OUTER>
+    static auto slot(const OUTER& outer)
+    {
+        using key_type = std::optional<std::tuple_element_t<J, outer_type>>;
+        if constexpr (J < std::tuple_size_v<OUTER>) {
+            return key_type(std::get<J>(outer));
+        } else {
+            return key_type();
+        }
+    }
+
+    // Outer key at level J for looking up, without a copy of the prefix where the container allows it
+    template<size_t J, typename OUTER>
+    static decltype(auto) key(const OUTER& outer)
+    {
+        if constexpr (!sorted) {
+            return slot<J>(outer);
+        } else if constexpr (J < std::tuple_size_v<OUTER>) {
+            return std::get<J>(outer);
+        } else {
+            return std::nullopt;
+        }
+    }
+
+    template<class D, typename OUTER, typename INNER, size_t... J, size_t... K>
+    std::pair<DATA*, bool> insert_at(D&& data,
+                                     const OUTER& outer,
+                                     const INNER& inner,
+                                     std::index_sequence<J...>,
+                                     std::index_sequence<K...>)
+    {
+        return m_tm.insert(std::forward<D>(data), slot<J>(outer)..., std::get<K>(inner)...);
+    }
+
+    template<typename F, typename OUTER, typename INNER>
+    static decltype(auto) call(F&& f, const OUTER& outer, const INNER& inner)
+    {
+        static_assert(std::tuple_size_v<OUTER> <= outer_levels && std::tuple_size_v<INNER> <= inner_levels,
+                      "Too many prefixes");
+        return invoke(
+            f, outer, inner, std::make_index_sequence<outer_levels>(), std::make_index_sequence<std::tuple_size_v<INNER>>());
+    }
+
+    template<typename F, typename OUTER, typename INNER, size_t... J, size_t... K>
+    static decltype(auto) invoke(F& f,
+                                 const OUTER& outer,
+                                 const INNER& inner,
+                                 std::index_sequence<J...>,
+                                 std::index_sequence<K...>)
+    {
+        return f(key<J>(outer)..., std::get<K>(inner)...);
+    }
+
+    // Candidates of one match. Nodes along the outer path, the nodes where every outer path length meets the inner
+    // levels and the data along the inner path below them are looked up on first use and kept.
+    template<typename ROOT, typename OUTER, typename INNER>
+    class matcher
+    {
+        template<size_t L>
+        using node_type = std::conditional_t<std::is_const_v<ROOT>,
+                                             const typename details::node_at<trie_type, L>::type,
+                                             typename details::node_at<trie_type, L>::type>;
+        using bound_type  = node_type<outer_levels>;
+        using result_type = std::conditional_t<std::is_const_v<ROOT>, const DATA*, DATA*>;
+
+        static constexpr size_t depth = std::tuple_size_v<OUTER>;
+        static constexpr size_t width = std::tuple_size_v<INNER> + 1;
+
+        template<size_t... L>
+        static auto path_of(std::index_sequence<L...>) -> std::tuple<node_type<L>*...>;
+
+        using path_type = decltype(path_of(std::make_index_sequence<depth + 1>()));
+
+        const OUTER&                                          m_outer;
+        const INNER&                                          m_inner;
+        path_type                                             m_path;
+        size_t                                                m_reached = 0;
+        std::array<bool, depth + 1>                           m_climbed{};
+        std::array<std::array<result_type, width>, depth + 1> m_data{};
+
+    public:
+        matcher(ROOT& root, const OUTER& outer, const INNER& inner)
+          : m_outer(outer)
+          , m_inner(inner)
+        {
+            std::get<0>(m_path) = &root;
+        }
+
+        // Data found with the given number of outer and inner prefixes
+        result_type at(size_t outer, size_t inner)
+        {
+            if (!m_climbed[outer]) {
+                m_climbed[outer] = true;
+                if (auto n = bound<0>(outer)) {
+                    size_t i = 0;
+                    std::apply(
+                        [&](const auto&... qs) {
+                            n->climb_pre(
+                                [&](auto& c) {
+                                    m_data[outer][i++] = c ? &*c : nullptr;
+                                    return true;
+                                },
+                                qs...);
+                        },
+                        m_inner);
+                }
+            }
+            return m_data[outer][inner];
+        }
+
+    private:
+        // Node where the outer path of the given length meets the inner levels
+        template<size_t L>
+        bound_type* bound(size_t outer)
+        {
+            if (outer == L) {
+                auto n = along<L>();
+                return n != nullptr ? pad<L>(*n) : nullptr;
+            }
+            if constexpr (L < depth) {
+                return bound<L + 1>(outer);
+            }
+            return nullptr;
+        }
+
+        // Node L levels down the outer path
+        template<size_t L>
+        node_type<L>* along()
+        {
+            if constexpr (L > 0) {
+                if (m_reached < L) {
+                    auto p = along<L - 1>();
+                    if (p != nullptr) {
+                        p->jump([&](auto& c) { std::get<L>(m_path) = &c; }, key<L - 1>(m_outer));
+                    }
+                    m_reached = L;
+                }
+            }
+            return std::get<L>(m_path);
+        }
+
+        // Descend from level L to the inner levels through empty prefixes
+        template<size_t L>
+        static bound_type* pad(node_type<L>& n)
+        {
+            if constexpr (L == outer_levels) {
+                return &n;
+            } else {
+                bound_type* rv = nullptr;
+                n.jump([&](auto& c) { rv = pad<L + 1>(c); }, key<L>(std::tuple<>()));
+                return rv;
+            }
+        }
+    };
+
+    template<typename ROOT, typename OUTER, typename INNER, typename PRECEDENCE>
+    static auto match_in(ROOT& root, const OUTER& outer, const INNER& inner, PRECEDENCE& precedence)
+    {
+        constexpr size_t depth = std::tuple_size_v<OUTER>;
+        constexpr size_t width = std::tuple_size_v<INNER> + 1;
+        static_assert(depth <= outer_levels && width <= inner_levels + 1, "Too many prefixes");
+
+        using order_type = std::array<match_depths, (depth + 1) * width>;
+        auto rank        = [&]() {
+            order_type order;
+            for (size_t i = 0; i < order.size(); ++i) {
+                order[i] = { i / width, i % width };
+            }
+            // Insertion sort keeps the few candidates in place and equal ones in order
+            for (size_t i = 1; i < order.size(); ++i) {
+                for (size_t j = i; j > 0 && precedence(order[j], order[j - 1]); --j) {
+                    std::swap(order[j], order[j - 1]);
+                }
+            }
+            return order;
+        };
+
+        matcher<ROOT, OUTER, INNER> m(root, outer, inner);
+        auto                        first = [&](const order_type& order) {
+            for (const auto& c : order) {
+                if (auto d = m.at(c.outer, c.inner)) {
+                    return d;
+                }
+            }
+            return decltype(m.at(0, 0))();
+        };
+
+        // Stateless precedence gives the same order every time
+        if constexpr (std::is_empty_v<PRECEDENCE>) {
+            static const order_type order = rank();
+            return first(order);
+        } else {
+            return first(rank());
+        }
+    }
+
+    trie_type m_tm;
+};
+
+template<typename POLICY, typename DATA, typename OUTER, typename INNER>
+using basic_oproduct = product<omap, POLICY, DATA, OUTER, INNER>;
+
+template<typename DATA, typename OUTER, typename INNER>
+using oproduct = basic_oproduct<policy, DATA, OUTER, INNER>;
+
+template<typename POLICY, typename DATA, typename OUTER, typename INNER>
+using basic_uproduct = product<umap, POLICY, DATA, OUTER, INNER>;
+
+template<typename DATA, typename OUTER, typename INNER>
+using uproduct = basic_uproduct<policy, DATA, OUTER, INNER>;
+
+} // namespace O3::collection
+
+#endif
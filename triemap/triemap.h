@@ -7,23 +7,558 @@
 #define O3_COLLECTION_TRIEMAP_DOT_H
 
 #include <optional>
+#include <memory>
+#include <vector>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <limits>
 #include <numeric>
+#include <algorithm>
+#include <functional>
+#include <type_traits>
+#include <utility>
+#include <tuple>
+#include <variant>
 #include <map>
+#include <set>
 #include <unordered_map>
 
 namespace O3::collection {
 
+//----------------------------------------------------------------------------------------------------------------------
+// Memory footprint and shape statistics. Byte counts are estimates based on the layout of the standard containers and do
+// not include memory owned by the data elements themselves.
+//----------------------------------------------------------------------------------------------------------------------
+struct statistics
+{
+    struct level
+    {
+        size_t                   nodes = 0; // Number of nodes at the level
+        size_t                   data  = 0; // Number of nodes holding data
+        std::map<size_t, size_t> fanout;    // Number of nodes by the number of their children
+    };
+
+    std::vector<level> levels;
+
+    size_t root_bytes  = 0; // Size of the root node object
+    size_t repo_bytes  = 0; // Heap bytes used by children containers, including the child node objects
+    size_t data_bytes  = 0; // Heap bytes used by out of line data
+    size_t allocations = 0; // Number of heap allocations
+
+    [[nodiscard]] size_t nodes() const
+    {
+        return std::accumulate(levels.begin(), levels.end(), size_t(0), [](size_t c, const level& l) {
+            return c + l.nodes;
+        });
+    }
+
+    [[nodiscard]] size_t data() const
+    {
+        return std::accumulate(levels.begin(), levels.end(), size_t(0), [](size_t c, const level& l) {
+            return c + l.data;
+        });
+    }
+
+    [[nodiscard]] size_t bytes() const
+    {
+        return root_bytes + repo_bytes + data_bytes;
+    }
+};
+
 namespace details {
 
+//----------------------------------------------------------------------------------------------------------------------
+// Heap footprint of children containers and data stores. The default assumes one allocation per element.
+//----------------------------------------------------------------------------------------------------------------------
+template<typename C>
+struct footprint
+{
+    static size_t bytes(const C& c)
+    {
+        return c.size() * sizeof(typename C::value_type);
+    }
+    static size_t allocations(const C& c)
+    {
+        return c.size();
+    }
+};
+
+// Red-black tree node carries color and three links in addition to the element
+template<typename K, typename T, typename C, typename A>
+struct footprint<std::map<K, T, C, A>>
+{
+    static size_t bytes(const std::map<K, T, C, A>& c)
+    {
+        return c.size() * (sizeof(typename std::map<K, T, C, A>::value_type) + 4 * sizeof(void*));
+    }
+    static size_t allocations(const std::map<K, T, C, A>& c)
+    {
+        return c.size();
+    }
+};
+
+// Hash table node carries a link and a cached hash code, bucket array is allocated unless there is a single bucket
+template<typename K, typename T, typename H, typename E, typename A>
+struct footprint<std::unordered_map<K, T, H, E, A>>
+{
+    static size_t bytes(const std::unordered_map<K, T, H, E, A>& c)
+    {
+        return c.size() * (sizeof(typename std::unordered_map<K, T, H, E, A>::value_type) + 2 * sizeof(void*)) +
+               (c.bucket_count() > 1 ? c.bucket_count() * sizeof(void*) : 0);
+    }
+    static size_t allocations(const std::unordered_map<K, T, H, E, A>& c)
+    {
+        return c.size() + (c.bucket_count() > 1 ? 1 : 0);
+    }
+};
+
+// Inline data store
+template<typename D>
+struct footprint<std::optional<D>>
+{
+    static size_t bytes(const std::optional<D>&)
+    {
+        return 0;
+    }
+    static size_t allocations(const std::optional<D>&)
+    {
+        return 0;
+    }
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+// Children container operations used by bulk construction. Ordered maps append with an end hint, so building from
+// sorted input costs amortized constant time per child. Containers that support it are sized up front.
+//----------------------------------------------------------------------------------------------------------------------
+template<typename R, typename = void>
+struct is_ordered : std::false_type
+{};
+template<typename R>
+struct is_ordered<R, std::void_t<typename R::key_compare>> : std::true_type
+{};
+
+// Children containers that iterate in key order, directly or once expanded
+template<typename R, typename = void>
+struct is_sorted : is_ordered<R>
+{};
+template<typename R>
+struct is_sorted<R, std::void_t<typename R::many_type>> : is_ordered<typename R::many_type>
+{};
+
+template<typename R, typename = void>
+struct has_append : std::false_type
+{};
+template<typename R>
+struct has_append<R, std::void_t<decltype(std::declval<R&>().append(std::declval<const typename R::key_type&>()))>>
+  : std::true_type
+{};
+
+template<typename R, typename = void>
+struct has_reserve : std::false_type
+{};
+template<typename R>
+struct has_reserve<R, std::void_t<decltype(std::declval<R&>().reserve(size_t()))>> : std::true_type
+{};
+
+template<typename R, typename K>
+typename R::mapped_type& append(R& repo, K&& k)
+{
+    if constexpr (has_append<R>::value) {
+        return repo.append(std::forward<K>(k));
+    } else if constexpr (is_ordered<R>::value) {
+        return repo
+            .emplace_hint(
+                repo.end(), std::piecewise_construct, std::forward_as_tuple(std::forward<K>(k)), std::forward_as_tuple())
+            ->second;
+    } else {
+        return repo[std::forward<K>(k)];
+    }
+}
+
+template<typename R>
+void reserve(R& repo, size_t n)
+{
+    if constexpr (has_reserve<R>::value) {
+        repo.reserve(n);
+    }
+}
+
+template<typename R, typename = void>
+struct has_compact : std::false_type
+{};
+template<typename R>
+struct has_compact<R, std::void_t<decltype(std::declval<R&>().compact())>> : std::true_type
+{};
+
+// Move the elements into a container allocated afresh and sized to fit, in iteration order. Keys are copied, the mapped
+// values are moved, so children keep their own containers.
+template<typename R>
+void relocate(R& repo)
+{
+    if constexpr (has_compact<R>::value) {
+        repo.compact();
+    } else {
+        R fresh;
+        reserve(fresh, repo.size());
+        for (auto& r : repo) {
+            if constexpr (is_ordered<R>::value) {
+                fresh.emplace_hint(fresh.end(), r.first, std::move(r.second));
+            } else {
+                fresh.emplace(r.first, std::move(r.second));
+            }
+        }
+        repo = std::move(fresh);
+    }
+}
+
+// Expected fan-out of nodes with the given number of levels below them, zero if the policy gives no hint. Hints name
+// every level from the root, so the root of a trie-map with that many levels reads the first one.
+template<typename POLICY, typename = void>
+struct fanout_hint
+{
+    static constexpr size_t levels = 0;
+
+    static constexpr size_t at(size_t)
+    {
+        return 0;
+    }
+};
+template<typename POLICY>
+struct fanout_hint<POLICY, std::void_t<decltype(POLICY::fanout)>>
+{
+    static constexpr size_t levels = POLICY::fanout.size();
+
+    static constexpr size_t at(size_t below)
+    {
+        return POLICY::fanout[levels - below];
+    }
+};
+
+// Policy of a trie-map with the given number of prefix levels, checked to hint the fan-out of every level if it does
+template<typename POLICY, size_t LEVELS>
+struct policy_for
+{
+    static_assert(fanout_hint<POLICY>::levels == 0 || fanout_hint<POLICY>::levels == LEVELS,
+                  "Fan-out hints must name every prefix level");
+    using type = POLICY;
+};
+
+// Insert node handle, leaving it with the caller if the key exists
+template<typename R>
+std::pair<typename R::mapped_type*, bool> graft(R& repo, typename R::node_type& nh)
+{
+    if (nh.empty()) {
+        return std::make_pair(nullptr, false);
+    }
+    auto rv = repo.insert(std::move(nh));
+    if (!rv.inserted) {
+        nh = std::move(rv.node);
+    }
+    return std::make_pair(&rv.position->second, rv.inserted);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+// Subtree hashes. A store that caches the hash of its subtree is touched on every non-const access to the node, which
+// invalidates the cache along the path from the root to any node that may have been modified. The data itself is only
+// exposed as const, see exposed.
+//----------------------------------------------------------------------------------------------------------------------
+template<typename S, typename = void>
+struct is_hashed : std::false_type
+{};
+template<typename S>
+struct is_hashed<S, std::void_t<decltype(std::declval<const S&>().cached())>> : std::true_type
+{};
+
+//----------------------------------------------------------------------------------------------------------------------
+// Subtree aggregates. A store that keeps the aggregate of its subtree names the monoid that combines them. Nodes of other
+// trie-maps see a monoid that aggregates nothing, so the code maintaining aggregates compiles for them and is never run.
+//----------------------------------------------------------------------------------------------------------------------
+template<typename S, typename = void>
+struct is_aggregated : std::false_type
+{};
+template<typename S>
+struct is_aggregated<S, std::void_t<typename S::monoid_type>> : std::true_type
+{};
+
+struct no_monoid
+{
+    using value_type = bool;
+
+    static bool identity()
+    {
+        return false;
+    }
+    template<typename D>
+    static bool lift(const D&)
+    {
+        return false;
+    }
+    static bool combine(bool, bool)
+    {
+        return false;
+    }
+};
+
+template<typename S, typename = void>
+struct monoid_of
+{
+    using type = no_monoid;
+};
+template<typename S>
+struct monoid_of<S, std::void_t<typename S::monoid_type>>
+{
+    using type = typename S::monoid_type;
+};
+
+template<typename M, typename = void>
+struct has_remove : std::false_type
+{};
+template<typename M>
+struct has_remove<M,
+                  std::void_t<decltype(M::remove(std::declval<const typename M::value_type&>(),
+                                                 std::declval<const typename M::value_type&>()))>> : std::true_type
+{};
+
+// Store with aggregates maintained by every modification
+template<typename S, typename = void>
+struct is_eager : std::false_type
+{};
+template<typename S>
+struct is_eager<S, std::enable_if_t<!S::lazy>> : std::true_type
+{};
+
+//----------------------------------------------------------------------------------------------------------------------
+// Data versions. A store that keeps past versions of the data names the type of their time stamps. Modifying the data in
+// place starts a new version holding a copy of the current one, and a node whose store keeps past versions is not removed
+// when its data is erased.
+//----------------------------------------------------------------------------------------------------------------------
+template<typename S, typename = void>
+struct is_versioned : std::false_type
+{};
+template<typename S>
+struct is_versioned<S, std::void_t<typename S::stamp_type>> : std::true_type
+{};
+
+// Stamps of other stores are never read
+struct no_stamp
+{
+    bool operator<(const no_stamp&) const
+    {
+        return false;
+    }
+};
+
+template<typename S, typename = void>
+struct stamp_of
+{
+    using type = no_stamp;
+};
+template<typename S>
+struct stamp_of<S, std::void_t<typename S::stamp_type>>
+{
+    using type = typename S::stamp_type;
+};
+
+template<typename S>
+decltype(auto) revise(S& s)
+{
+    if constexpr (is_versioned<S>::value) {
+        return s.revise();
+    } else {
+        return *s;
+    }
+}
+
+template<typename S>
+bool vacant(const S& s)
+{
+    if constexpr (is_versioned<S>::value) {
+        return s.versions() == 0;
+    } else {
+        return !s.has_value();
+    }
+}
+
+template<typename S>
+void touch(S& s)
+{
+    if constexpr (is_hashed<S>::value || is_aggregated<S>::value) {
+        s.touch();
+    }
+}
+
+// Run modification f of a part of the subtree of a node with store s. Part returns the aggregate of the part, which is
+// removed from the aggregate of the node before and combined into it after the modification. Without a way to remove a
+// part, or when the aggregate of the node is stale, it is recomputed by total instead. Other stores, including lazy
+// aggregates, are only touched.
+template<typename S, typename T, typename PART, typename F>
+auto modify(S& s, T&& total, PART&& part, F&& f)
+{
+    if constexpr (is_eager<S>::value) {
+        using M = typename S::monoid_type;
+        if constexpr (has_remove<M>::value) {
+            if (!s.dirty()) {
+                auto sum    = s.total();
+                auto before = part();
+                s.touch();
+                auto rv = f();
+                s.total(M::combine(M::remove(sum, before), part()));
+                return rv;
+            }
+        }
+        s.touch();
+        auto rv = f();
+        total();
+        return rv;
+    } else {
+        touch(s);
+        return f();
+    }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+// Children ranking. Nodes of trie-maps with a ranked_policy keep their children in a set ordered by decreasing score,
+// with keys breaking ties. Modifications of a child through the trie-map move its entry, any other non-const access to
+// the node marks the set stale, and the next read rebuilds it. Other nodes derive from an empty base instead.
+//----------------------------------------------------------------------------------------------------------------------
+struct no_ranking
+{};
+
+template<typename KEY, typename SCORE, typename CHILD>
+class ranking
+{
+public:
+    using score_type = std::decay_t<std::invoke_result_t<const SCORE&, const CHILD&>>;
+    using entry_type = std::pair<score_type, KEY>;
+
+    // Score of the child, none if there is no child
+    std::optional<score_type> score(const CHILD* c) const
+    {
+        return c ? std::optional<score_type>(SCORE()(*c)) : std::nullopt;
+    }
+
+    void touch()
+    {
+        m_stale = true;
+    }
+    [[nodiscard]] bool stale() const
+    {
+        return m_stale;
+    }
+
+    // Move the entry of the child with key k after a modification
+    void replace(const KEY& k, const std::optional<score_type>& before, const std::optional<score_type>& after)
+    {
+        if (before) {
+            if (after && !(*before < *after) && !(*after < *before)) {
+                return;
+            }
+            m_order.erase(entry_type(*before, k));
+        }
+        if (after) {
+            m_order.emplace(*after, k);
+        }
+    }
+
+    // Entries in decreasing score order, rebuilt from the children container if stale
+    template<typename R>
+    const auto& order(const R& repo) const
+    {
+        if (m_stale) {
+            m_order.clear();
+            for (const auto& r : repo) {
+                m_order.emplace(SCORE()(r.second), r.first);
+            }
+            m_stale = false;
+        }
+        return m_order;
+    }
+
+private:
+    struct by_score
+    {
+        bool operator()(const entry_type& a, const entry_type& b) const
+        {
+            return b.first < a.first || (!(a.first < b.first) && a.second < b.second);
+        }
+    };
+
+    mutable std::set<entry_type, by_score> m_order;
+    mutable bool                           m_stale = false;
+};
+
+template<typename POLICY, typename = void>
+struct is_ranked : std::false_type
+{};
+template<typename POLICY>
+struct is_ranked<POLICY, std::void_t<typename POLICY::score>> : std::true_type
+{};
+
+template<typename POLICY, typename KEY, typename CHILD, typename = void>
+struct ranking_of
+{
+    using type = no_ranking;
+};
+template<typename POLICY, typename KEY, typename CHILD>
+struct ranking_of<POLICY, KEY, CHILD, std::void_t<typename POLICY::score>>
+{
+    using type = ranking<KEY, typename POLICY::score, CHILD>;
+};
+
+// Finalizer of splitmix64, spreads hashes of consecutive integers over all bits
+inline uint64_t mix(uint64_t h)
+{
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ull;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebull;
+    return h ^ (h >> 31);
+}
+
+template<typename T>
+uint64_t hash_value(const T& t)
+{
+    return mix(static_cast<uint64_t>(std::hash<T>()(t)));
+}
+
+template<typename S>
+uint64_t hash_store(const S& s)
+{
+    return s ? hash_value(*s) : 0x9e3779b97f4a7c15ull;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+// Data seen through non-const access to a node. Trie-maps that cache subtree hashes, aggregates or rankings expose it as
+// const, so it is only modified through insert, update and erase, which maintain the caches. A pointer kept across a
+// read of the cache could otherwise modify the data behind its back.
+//----------------------------------------------------------------------------------------------------------------------
+template<typename POLICY, typename DATA>
+struct exposed
+{
+    using store_type = typename POLICY::template store<DATA>;
+    using type       = std::conditional_t<
+        is_hashed<store_type>::value || is_aggregated<store_type>::value || is_ranked<POLICY>::value,
+        const DATA,
+        DATA>;
+};
+
 //----------------------------------------------------------------------------------------------------------------------
 // Trie-map collection base case.
 //----------------------------------------------------------------------------------------------------------------------
-template<template<typename K, typename T> class MAP, typename DATA, typename... PFIXS>
+template<template<typename K, typename T> class MAP, typename POLICY, typename DATA, typename... PFIXS>
 class triemap
 {
 public:
-    using this_type = triemap<MAP, DATA>;
-    using data_type = DATA;
+    using this_type      = triemap<MAP, POLICY, DATA>;
+    using data_type      = DATA;
+    using store_type     = typename POLICY::template store<DATA>;
+    using monoid_type    = typename details::monoid_of<store_type>::type;
+    using aggregate_type = typename monoid_type::value_type;
+    using stamp_type     = typename details::stamp_of<store_type>::type;
+    using exposed_type   = typename details::exposed<POLICY, DATA>::type;
+
+    template<template<typename, typename> class, typename, typename, typename...>
+    friend class triemap;
 
     //------------------------------------------------------------------------------------------------------------------
     // Check if node holds data
@@ -40,8 +575,9 @@ public:
     {
         return *m_data;
     }
-    DATA& operator*()
+    exposed_type& operator*()
     {
+        details::touch(m_data);
         return *m_data;
     }
 
@@ -49,8 +585,9 @@ public:
     {
         return &*m_data;
     }
-    DATA* operator->()
+    exposed_type* operator->()
     {
+        details::touch(m_data);
         return &*m_data;
     }
 
@@ -60,11 +597,31 @@ public:
     template<class D>
     auto insert(D&& data)
     {
-        bool exists = m_data.has_value();
-        if (!exists) {
-            m_data = std::forward<D>(data);
-        }
-        return std::make_pair(&*m_data, !exists);
+        return modify([&] { return own(); },
+                      [&] {
+                          bool exists = m_data.has_value();
+                          if (!exists) {
+                              m_data = std::forward<D>(data);
+                          }
+                          return std::make_pair(static_cast<exposed_type*>(&*m_data), !exists);
+                      });
+    }
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Apply f to the data, return false if there is none. Unlike modifying the data through a pointer, keeps the
+    // aggregate up to date.
+    //------------------------------------------------------------------------------------------------------------------
+    template<typename F>
+    bool update(F&& f)
+    {
+        return modify([&] { return own(); },
+                      [&] {
+                          if (!m_data) {
+                              return false;
+                          }
+                          f(details::revise(m_data));
+                          return true;
+                      });
     }
 
     //------------------------------------------------------------------------------------------------------------------
@@ -72,9 +629,12 @@ public:
     //------------------------------------------------------------------------------------------------------------------
     size_t erase()
     {
-        size_t count = m_data ? 1 : 0;
-        m_data.reset();
-        return count;
+        return modify([&] { return own(); },
+                      [&] {
+                          size_t count = m_data ? 1 : 0;
+                          m_data.reset();
+                          return count;
+                      });
     }
 
     //------------------------------------------------------------------------------------------------------------------
@@ -82,7 +642,31 @@ public:
     //------------------------------------------------------------------------------------------------------------------
     void clear()
     {
+        details::touch(m_data);
         m_data.reset();
+        if constexpr (details::is_aggregated<store_type>::value) {
+            total();
+        }
+    }
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Merge data of another node. Resolve is called as resolve(data, other) when both nodes hold data.
+    //------------------------------------------------------------------------------------------------------------------
+    template<typename F>
+    void merge(this_type&& oth, F&& resolve)
+    {
+        details::touch(m_data);
+        if (oth.m_data) {
+            if (m_data) {
+                resolve(details::revise(m_data), std::move(*oth.m_data));
+            } else {
+                m_data = std::move(*oth.m_data);
+            }
+        }
+        oth.clear();
+        if constexpr (details::is_aggregated<store_type>::value) {
+            total();
+        }
     }
 
     //------------------------------------------------------------------------------------------------------------------
@@ -94,11 +678,19 @@ public:
     }
 
     //------------------------------------------------------------------------------------------------------------------
-    // Return true if there is no data at the current and all children nodes
+    // Return number of immediate children
+    //------------------------------------------------------------------------------------------------------------------
+    [[nodiscard]] size_t fanout() const
+    {
+        return 0;
+    }
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Return true if there is no data at the current and all children nodes, nor past versions kept by versioned_policy
     //------------------------------------------------------------------------------------------------------------------
     [[nodiscard]] bool empty() const
     {
-        return !m_data.has_value();
+        return details::vacant(m_data);
     }
 
     //------------------------------------------------------------------------------------------------------------------
@@ -125,17 +717,62 @@ public:
         return 0;
     }
 
+    //------------------------------------------------------------------------------------------------------------------
+    // Return memory footprint and shape statistics
+    //------------------------------------------------------------------------------------------------------------------
+    [[nodiscard]] statistics stats() const
+    {
+        statistics st;
+        st.root_bytes = sizeof(this_type);
+        collect(st, 0);
+        return st;
+    }
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Return hash of the subtree. It is cached in the node and only recomputed along paths modified since the last call.
+    //------------------------------------------------------------------------------------------------------------------
+    [[nodiscard]] uint64_t digest() const
+    {
+        static_assert(details::is_hashed<store_type>::value, "Node policy does not keep subtree hashes");
+        if (m_data.dirty()) {
+            m_data.cache(details::mix(details::hash_store(m_data)));
+        }
+        return m_data.cached();
+    }
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Return aggregate of the subtree, see aggregate_policy
+    //------------------------------------------------------------------------------------------------------------------
+    const aggregate_type* aggregate() const
+    {
+        static_assert(details::is_aggregated<store_type>::value, "Node policy does not keep subtree aggregates");
+        return aggregate_at();
+    }
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Recompute stale aggregates
+    //------------------------------------------------------------------------------------------------------------------
+    void refresh() const
+    {
+        static_assert(details::is_aggregated<store_type>::value, "Node policy does not keep subtree aggregates");
+        total();
+    }
+
     //------------------------------------------------------------------------------------------------------------------
     // Find the data given the list of prefixes
     //------------------------------------------------------------------------------------------------------------------
     const DATA* find() const
     {
-        return m_data ? &*m_data : nullptr;
+        auto rv = find_at(0);
+        probe_type::find(rv != nullptr);
+        return rv;
     }
 
-    DATA* find()
+    exposed_type* find()
     {
-        return m_data ? &*m_data : nullptr;
+        auto rv = find_at(0);
+        probe_type::find(rv != nullptr);
+        return rv;
     }
 
     //------------------------------------------------------------------------------------------------------------------
@@ -143,12 +780,53 @@ public:
     //------------------------------------------------------------------------------------------------------------------
     const DATA* match() const
     {
-        return m_data ? &*m_data : nullptr;
+        size_t depth = 0;
+        auto   rv    = match_at(0, depth);
+        probe_type::match(rv != nullptr, depth);
+        return rv;
     }
 
-    DATA* match()
+    exposed_type* match()
     {
-        return m_data ? &*m_data : nullptr;
+        size_t depth = 0;
+        auto   rv    = match_at(0, depth);
+        probe_type::match(rv != nullptr, depth);
+        return rv;
+    }
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Find the data as of time t, see versioned_policy
+    //------------------------------------------------------------------------------------------------------------------
+    const DATA* find_as_of(const stamp_type& t) const
+    {
+        static_assert(details::is_versioned<store_type>::value, "Node policy does not keep versions");
+        return m_data.as_of(t);
+    }
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Find the data as of time t as far as possible along the list of prefixes
+    //------------------------------------------------------------------------------------------------------------------
+    const DATA* match_as_of(const stamp_type& t) const
+    {
+        static_assert(details::is_versioned<store_type>::value, "Node policy does not keep versions");
+        return m_data.as_of(t);
+    }
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Drop versions that no lookup as of the watermark or later can see, return their number
+    //------------------------------------------------------------------------------------------------------------------
+    size_t trim(const stamp_type& watermark)
+    {
+        static_assert(details::is_versioned<store_type>::value, "Node policy does not keep versions");
+        return m_data.trim(watermark);
+    }
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Relocate the subtree, a node at the last level has nothing to relocate
+    //------------------------------------------------------------------------------------------------------------------
+    size_t compact()
+    {
+        return 0;
     }
 
     //------------------------------------------------------------------------------------------------------------------
@@ -162,6 +840,7 @@ public:
     template<typename F>
     void jump(F&& f)
     {
+        details::touch(m_data);
         f(*this);
     }
 
@@ -171,15 +850,13 @@ public:
     template<typename PREF, typename POSF>
     void climb(PREF&& pref, POSF&& posf) const
     {
-        pref(*this);
-        posf(*this);
+        probe_type::climb(climb_at(0, std::forward<PREF>(pref), std::forward<POSF>(posf)));
     }
 
     template<typename PREF, typename POSF>
     void climb(PREF&& pref, POSF&& posf)
     {
-        pref(*this);
-        posf(*this);
+        probe_type::climb(climb_at(0, std::forward<PREF>(pref), std::forward<POSF>(posf)));
     }
 
     //------------------------------------------------------------------------------------------------------------------
@@ -238,6 +915,7 @@ public:
     template<typename PREF, typename POSF, typename... PS>
     void traverse_dfs(PREF&& pref, POSF&& posf, PS&&... ps)
     {
+        details::touch(m_data);
         pref(*this, std::forward<PS>(ps)...);
         posf(*this, std::forward<PS>(ps)...);
     }
@@ -289,19 +967,134 @@ public:
     }
 
 private:
-    std::optional<data_type> m_data;
-};
+    using probe_type = typename POLICY::probe;
+
+    // Lookup helpers that keep track of the distance from the node where the lookup started
+    const DATA* find_at(size_t) const
+    {
+        return m_data ? &*m_data : nullptr;
+    }
+    exposed_type* find_at(size_t)
+    {
+        details::touch(m_data);
+        return m_data ? &*m_data : nullptr;
+    }
+
+    const DATA* match_at(size_t level, size_t& depth) const
+    {
+        depth = level;
+        return m_data ? &*m_data : nullptr;
+    }
+    exposed_type* match_at(size_t level, size_t& depth)
+    {
+        details::touch(m_data);
+        depth = level;
+        return m_data ? &*m_data : nullptr;
+    }
+
+    template<typename PREF, typename POSF>
+    size_t climb_at(size_t, PREF&& pref, POSF&& posf) const
+    {
+        pref(*this);
+        posf(*this);
+        return 1;
+    }
+    template<typename PREF, typename POSF>
+    size_t climb_at(size_t, PREF&& pref, POSF&& posf)
+    {
+        details::touch(m_data);
+        pref(*this);
+        posf(*this);
+        return 1;
+    }
+
+    // Aggregate of the subtree, recomputed if it is stale
+    const aggregate_type& total() const
+    {
+        if constexpr (details::is_aggregated<store_type>::value) {
+            if (m_data.dirty()) {
+                m_data.total(own());
+            }
+            return m_data.total();
+        } else {
+            static const aggregate_type none = monoid_type::identity();
+            return none;
+        }
+    }
+
+    // Aggregate of the data in this node alone
+    aggregate_type own() const
+    {
+        return m_data ? monoid_type::lift(*m_data) : monoid_type::identity();
+    }
+
+    // Run modification f of the part of the subtree whose aggregate is returned by part
+    template<typename PART, typename F>
+    auto modify(PART&& part, F&& f)
+    {
+        return details::modify(m_data, [this] { total(); }, std::forward<PART>(part), std::forward<F>(f));
+    }
+
+    const aggregate_type* aggregate_at() const
+    {
+        return &total();
+    }
+
+    // Leaves have no children to rank
+    template<typename F>
+    void top_at(F&, size_t) const
+    {}
+
+    // Accumulate statistics of the subtree
+    void collect(statistics& st, size_t level) const
+    {
+        if (st.levels.size() <= level) {
+            st.levels.resize(level + 1);
+        }
+        auto& lv = st.levels[level];
+        lv.nodes += 1;
+        lv.data += m_data ? 1 : 0;
+        lv.fanout[0] += 1;
+        st.data_bytes += footprint<store_type>::bytes(m_data);
+        st.allocations += footprint<store_type>::allocations(m_data);
+    }
+
+    store_type m_data;
+};
 
 //----------------------------------------------------------------------------------------------------------------------
 // Trie-map. A collection of elements indexed by list of prefixes.
 //----------------------------------------------------------------------------------------------------------------------
-template<template<typename K, typename T> class MAP, typename DATA, typename PFIX, typename... PFIXS>
-class triemap<MAP, DATA, PFIX, PFIXS...>
+template<template<typename K, typename T> class MAP, typename POLICY, typename DATA, typename PFIX, typename... PFIXS>
+class triemap<MAP, POLICY, DATA, PFIX, PFIXS...>
+  : private details::ranking_of<POLICY, PFIX, triemap<MAP, POLICY, DATA, PFIXS...>>::type
 {
 public:
-    using this_type = triemap<MAP, DATA, PFIX, PFIXS...>;
-    using data_type = DATA;
-    using repo_type = MAP<PFIX, triemap<MAP, DATA, PFIXS...>>;
+    using this_type      = triemap<MAP, POLICY, DATA, PFIX, PFIXS...>;
+    using data_type      = DATA;
+    using store_type     = typename POLICY::template store<DATA>;
+    using monoid_type    = typename details::monoid_of<store_type>::type;
+    using aggregate_type = typename monoid_type::value_type;
+    using stamp_type     = typename details::stamp_of<store_type>::type;
+    using exposed_type   = typename details::exposed<POLICY, DATA>::type;
+    using prefix_type    = PFIX;
+    using child_type     = triemap<MAP, POLICY, DATA, PFIXS...>;
+    using repo_type      = MAP<PFIX, child_type>;
+    using node_type      = typename repo_type::node_type;
+    using rank_type      = typename details::ranking_of<POLICY, PFIX, child_type>::type;
+
+    template<template<typename, typename> class, typename, typename, typename...>
+    friend class triemap;
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Create an empty node, with the children container sized for the fan-out hinted by the policy
+    //------------------------------------------------------------------------------------------------------------------
+    triemap()
+    {
+        if constexpr (hint > 0) {
+            details::reserve(m_repo, hint);
+        }
+    }
 
     //------------------------------------------------------------------------------------------------------------------
     // Check if node holds data
@@ -318,8 +1111,9 @@ public:
     {
         return *m_data;
     }
-    DATA& operator*()
+    exposed_type& operator*()
     {
+        touch();
         return *m_data;
     }
 
@@ -327,8 +1121,9 @@ public:
     {
         return &*m_data;
     }
-    DATA* operator->()
+    exposed_type* operator->()
     {
+        touch();
         return &*m_data;
     }
 
@@ -338,17 +1133,154 @@ public:
     template<class D>
     auto insert(D&& data)
     {
-        bool exists = m_data.has_value();
-        if (!exists) {
-            m_data = std::forward<D>(data);
-        }
-        return std::make_pair(&*m_data, !exists);
+        return modify([&] { return own(); },
+                      [&] {
+                          bool exists = m_data.has_value();
+                          if (!exists) {
+                              m_data = std::forward<D>(data);
+                          }
+                          return std::make_pair(static_cast<exposed_type*>(&*m_data), !exists);
+                      });
     }
 
     template<class D, typename P, typename... PS>
     auto insert(D&& data, P&& p, PS&&... ps)
     {
-        return m_repo[p].insert(std::forward<D>(data), std::forward<PS>(ps)...);
+        if constexpr (sizeof...(PS) == 0 && std::is_same_v<std::decay_t<D>, node_type>) {
+            static_assert(!std::is_lvalue_reference_v<D>, "Node handle must be passed as rvalue");
+            if (data.empty()) {
+                return details::graft(m_repo, data);
+            }
+            data.key() = std::forward<P>(p);
+            if constexpr (details::is_aggregated<store_type>::value || ranked) {
+                auto k = data.key();
+                return modify_at(k, [&] { return total_at(k); }, [&] { return details::graft(m_repo, data); });
+            } else {
+                touch();
+                return details::graft(m_repo, data);
+            }
+        } else {
+            // An empty handle is not grafted, so the nodes on the way are not created either. Any other handle is only
+            // refused when its key is taken, and then the nodes on the way exist already.
+            if constexpr (grafts<D, P, PS...>()) {
+                if (data.empty()) {
+                    return decltype(m_repo[p].insert(std::forward<D>(data), std::forward<PS>(ps)...))(nullptr, false);
+                }
+            }
+            // The child is created inside the modification, so the ranking sees it as new
+            child_type* c = nullptr;
+            return modify_at(p, [&] { return c ? c->total() : total_at(p); }, [&] {
+                c = &m_repo[p];
+                return c->insert(std::forward<D>(data), std::forward<PS>(ps)...);
+            });
+        }
+    }
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Apply f to the data given the list of prefixes, return false if there is none. Unlike modifying the data through
+    // a pointer, keeps the aggregates along the path up to date.
+    //------------------------------------------------------------------------------------------------------------------
+    template<typename F>
+    bool update(F&& f)
+    {
+        return modify([&] { return own(); },
+                      [&] {
+                          if (!m_data) {
+                              return false;
+                          }
+                          f(details::revise(m_data));
+                          return true;
+                      });
+    }
+
+    template<typename F, typename P, typename... PS>
+    bool update(F&& f, P&& p, PS&&... ps)
+    {
+        auto itr = m_repo.find(std::forward<P>(p));
+        if (itr == m_repo.end()) {
+            return false;
+        }
+        return modify_at(itr->first, [&] { return itr->second.total(); }, [&] {
+            return itr->second.update(std::forward<F>(f), std::forward<PS>(ps)...);
+        });
+    }
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Return child node for the given prefix, creating an empty one if it does not exist
+    //------------------------------------------------------------------------------------------------------------------
+    template<typename P>
+    child_type& child(P&& p)
+    {
+        touch();
+        return m_repo[std::forward<P>(p)];
+    }
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Return child node for a prefix that does not order before any existing child, creating an empty one if it does
+    // not exist. Ordered trie-maps insert it without a search, so appending children in key order builds the trie-map
+    // in linear time. Any order is still correct, only slower.
+    //------------------------------------------------------------------------------------------------------------------
+    template<typename P>
+    child_type& append(P&& p)
+    {
+        touch();
+        return details::append(m_repo, std::forward<P>(p));
+    }
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Prepare the node given the list of prefixes for the given number of children, creating the nodes on the way. A
+    // bulk load that knows the size of a subtree sizes its container once instead of rehashing it as it grows. It is a
+    // no-op for ordered trie-maps.
+    //------------------------------------------------------------------------------------------------------------------
+    template<typename... PS>
+    void reserve(size_t n, PS&&... ps)
+    {
+        if constexpr (sizeof...(PS) == 0) {
+            details::reserve(m_repo, n);
+        } else {
+            static_assert(sizeof...(PS) <= sizeof...(PFIXS), "Nodes at the last level have no children");
+            reserve_at(n, std::forward<PS>(ps)...);
+        }
+    }
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Relocate the children of the node given the list of prefixes into a container allocated afresh and sized to fit.
+    // Unordered containers keep the buckets of their peak size after erasures, and the nodes of a long-lived trie-map
+    // end up scattered over the heap. Only the children are moved, their own containers stay where they are. Returns
+    // the number of relocated children, or zero if there is no such node.
+    //------------------------------------------------------------------------------------------------------------------
+    template<typename... PS>
+    size_t shrink_to_fit(PS&&... ps)
+    {
+        if constexpr (sizeof...(PS) == 0) {
+            details::relocate(m_repo);
+            return m_repo.size();
+        } else {
+            static_assert(sizeof...(PS) <= sizeof...(PFIXS), "Nodes at the last level have no children");
+            return relocate_at<false>(std::forward<PS>(ps)...);
+        }
+    }
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Relocate the subtree given the list of prefixes with shrink_to_fit of every node in depth-first order, so that
+    // the children containers are allocated afresh in the order a traversal visits them. Returns the number of
+    // relocated nodes. The content, cached hashes, aggregates and rankings are unchanged, but pointers into the subtree
+    // are not valid anymore. A whole trie-map is compacted incrementally, interleaved with other work, by
+    // shrink_to_fit() of the root followed by compact(prefix) of its children one at a time, or of smaller subtrees
+    // further down.
+    //------------------------------------------------------------------------------------------------------------------
+    template<typename... PS>
+    size_t compact(PS&&... ps)
+    {
+        if constexpr (sizeof...(PS) == 0) {
+            size_t count = shrink_to_fit();
+            for (auto& r : m_repo) {
+                count += r.second.compact();
+            }
+            return count;
+        } else {
+            return relocate_at<true>(std::forward<PS>(ps)...);
+        }
     }
 
     //------------------------------------------------------------------------------------------------------------------
@@ -356,32 +1288,109 @@ public:
     //------------------------------------------------------------------------------------------------------------------
     size_t erase()
     {
-        size_t count = m_data ? 1 : 0;
-        m_data.reset();
-        return count;
+        return modify([&] { return own(); },
+                      [&] {
+                          size_t count = m_data ? 1 : 0;
+                          m_data.reset();
+                          return count;
+                      });
     }
 
     template<typename P, typename... PS>
     size_t erase(P&& p, PS&&... ps)
     {
-        size_t count = 0;
-        auto   itr   = m_repo.find(std::forward<P>(p));
-        if (itr != m_repo.end()) {
-            count = itr->second.erase(std::forward<PS>(ps)...);
-            if (itr->second.empty()) {
-                m_repo.erase(itr);
+        auto itr = m_repo.find(p);
+        if (itr == m_repo.end()) {
+            return size_t(0);
+        }
+        bool gone = false;
+        return modify_at(p, [&] { return gone ? monoid_type::identity() : itr->second.total(); }, [&] {
+                          size_t count = itr->second.erase(std::forward<PS>(ps)...);
+                          if (itr->second.empty()) {
+                              m_repo.erase(itr);
+                              gone = true;
+                          }
+                          return count;
+                      });
+    }
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Detach the subtree at the given list of prefixes. Returns a node handle of the underlying map that owns the subtree,
+    // or an empty handle if there is no such subtree. Parents left empty are removed as with erase. The handle can be
+    // grafted back with insert(std::move(handle), prefixes...) at any node of the same level, where the last prefix
+    // becomes its key. Neither the data nor the children containers of the subtree are copied or moved.
+    //------------------------------------------------------------------------------------------------------------------
+    template<typename P, typename... PS>
+    auto extract(P&& p, PS&&... ps)
+    {
+        if constexpr (sizeof...(PS) == 0) {
+            return modify_at(p, [&] { return total_at(p); }, [&] { return m_repo.extract(p); });
+        } else {
+            using handle_type = decltype(m_repo.begin()->second.extract(std::forward<PS>(ps)...));
+
+            auto itr = m_repo.find(p);
+            if (itr == m_repo.end()) {
+                return handle_type();
             }
+            bool gone = false;
+            return modify_at(p, [&] { return gone ? monoid_type::identity() : itr->second.total(); }, [&] {
+                              auto nh = itr->second.extract(std::forward<PS>(ps)...);
+                              if (itr->second.empty()) {
+                                  m_repo.erase(itr);
+                                  gone = true;
+                              }
+                              return nh;
+                          });
         }
-        return count;
     }
 
     //------------------------------------------------------------------------------------------------------------------
-    // Clear all data
+    // Clear all data. With versioned_policy every node records the erasure of its data and is kept while it holds
+    // versions, as with erase.
     //------------------------------------------------------------------------------------------------------------------
     void clear()
     {
+        touch();
         m_data.reset();
-        m_repo.clear();
+        if constexpr (details::is_versioned<store_type>::value) {
+            // Nodes keep their past versions, so the data of every node is erased instead
+            for (auto itr = m_repo.begin(); itr != m_repo.end();) {
+                itr->second.clear();
+                itr = itr->second.empty() ? m_repo.erase(itr) : std::next(itr);
+            }
+        } else {
+            m_repo.clear();
+        }
+        if constexpr (details::is_aggregated<store_type>::value) {
+            total();
+        }
+    }
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Merge another trie-map into this one and leave the other one empty. Children missing here are spliced over whole,
+    // without copying or moving their elements. Only children present in both are merged recursively, and resolve is
+    // called as resolve(data, other) when both nodes hold data.
+    //------------------------------------------------------------------------------------------------------------------
+    template<typename F>
+    void merge(this_type&& oth, F&& resolve)
+    {
+        touch();
+        if (oth.m_data) {
+            if (m_data) {
+                resolve(details::revise(m_data), std::move(*oth.m_data));
+            } else {
+                m_data = std::move(*oth.m_data);
+            }
+        }
+
+        m_repo.merge(oth.m_repo);
+        for (auto& r : oth.m_repo) {
+            m_repo.find(r.first)->second.merge(std::move(r.second), resolve);
+        }
+        oth.clear();
+        if constexpr (details::is_aggregated<store_type>::value) {
+            total();
+        }
     }
 
     //------------------------------------------------------------------------------------------------------------------
@@ -393,11 +1402,19 @@ public:
     }
 
     //------------------------------------------------------------------------------------------------------------------
-    // Return true if there is no data at the current and all children nodes
+    // Return number of immediate children
+    //------------------------------------------------------------------------------------------------------------------
+    [[nodiscard]] size_t fanout() const
+    {
+        return m_repo.size();
+    }
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Return true if there is no data at the current and all children nodes, nor past versions kept by versioned_policy
     //------------------------------------------------------------------------------------------------------------------
     [[nodiscard]] bool empty() const
     {
-        return !m_data.has_value() &&
+        return details::vacant(m_data) &&
                std::all_of(m_repo.begin(), m_repo.end(), [](const typename repo_type::value_type& r) {
                    return r.second.empty();
                });
@@ -439,55 +1456,164 @@ public:
     }
 
     //------------------------------------------------------------------------------------------------------------------
-    // Find the data given the list of prefixes
+    // Return memory footprint and shape statistics
     //------------------------------------------------------------------------------------------------------------------
-    const DATA* find() const
+    [[nodiscard]] statistics stats() const
     {
-        return m_data ? &*m_data : nullptr;
+        statistics st;
+        st.root_bytes = sizeof(this_type);
+        collect(st, 0);
+        return st;
     }
-    template<typename P, typename... PS>
-    const DATA* find(P&& p, PS&&... ps) const
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Return hash of the subtree. It is cached in the node and only recomputed along paths modified since the last call.
+    // Children are combined in an order independent way, so ordered and unordered trie-maps with the same content have
+    // the same hash. Data is modified through update, as non-const lookups return it as const. A node reached through
+    // non-const access, such as child, is modified before the next call, not after, as only the access marks its path.
+    //------------------------------------------------------------------------------------------------------------------
+    [[nodiscard]] uint64_t digest() const
     {
-        auto itr = m_repo.find(std::forward<P>(p));
-        return itr != m_repo.end() ? itr->second.find(std::forward<PS>(ps)...) : nullptr;
+        static_assert(details::is_hashed<store_type>::value, "Node policy does not keep subtree hashes");
+        if (m_data.dirty()) {
+            uint64_t h = 0;
+            for (const auto& r : m_repo) {
+                h += details::mix(details::hash_value(r.first) ^ r.second.digest());
+            }
+            m_data.cache(details::mix(details::hash_store(m_data) + details::mix(h)));
+        }
+        return m_data.cached();
     }
 
-    DATA* find()
+    //------------------------------------------------------------------------------------------------------------------
+    // Return aggregate of the subtree given the list of prefixes, or null if there is no such node. See aggregate_policy.
+    // Aggregates stay up to date through insert, erase, update, extract, merge and clear, and non-const lookups return
+    // const data. Non-const access to a node, such as child or a non-const traversal, marks the path to it stale, and
+    // the next read recomputes it from the children, so a node reached that way is modified before the next read.
+    //------------------------------------------------------------------------------------------------------------------
+    template<typename... PS>
+    const aggregate_type* aggregate(PS&&... ps) const
     {
-        return m_data ? &*m_data : nullptr;
+        static_assert(details::is_aggregated<store_type>::value, "Node policy does not keep subtree aggregates");
+        return aggregate_at(std::forward<PS>(ps)...);
     }
-    template<typename P, typename... PS>
-    DATA* find(P&& p, PS&&... ps)
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Visit at most k children of the node given the list of prefixes in the order of decreasing score, see
+    // ranked_policy. Visiting stops early when f returns false, as in traverse_level. Modifications through insert,
+    // erase, update, extract and graft maintain the ranking, so it then takes O(k) lookups and does not look at the
+    // other children. Any other non-const access to the node, such as a non-const find, jump or traversal, marks the
+    // ranking stale, and the next call rebuilds it from all children in O(n log n). Data is modified through update,
+    // as non-const lookups return it as const, and a node reached through non-const access is modified before the next
+    // call, not after, as only the access marks the ranking.
+    //------------------------------------------------------------------------------------------------------------------
+    template<typename F, typename... PS>
+    void top_k(F&& f, size_t k, PS&&... ps) const
     {
-        auto itr = m_repo.find(std::forward<P>(p));
-        return itr != m_repo.end() ? itr->second.find(std::forward<PS>(ps)...) : nullptr;
+        static_assert(ranked, "Node policy does not rank children");
+        top_at(f, k, std::forward<PS>(ps)...);
+    }
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Recompute stale aggregates of the subtree in a post order traversal that only descends into stale nodes, so each
+    // of them is combined from its children once and clean subtrees are not visited
+    //------------------------------------------------------------------------------------------------------------------
+    void refresh() const
+    {
+        static_assert(details::is_aggregated<store_type>::value, "Node policy does not keep subtree aggregates");
+        traverse_dfs([](const auto& n, auto&&...) { return n.m_data.dirty(); },
+                     [](const auto& n, auto&&...) {
+                         n.total();
+                         return true;
+                     });
+    }
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Find the data given the list of prefixes
+    //------------------------------------------------------------------------------------------------------------------
+    template<typename... PS>
+    const DATA* find(PS&&... ps) const
+    {
+        auto rv = find_at(0, std::forward<PS>(ps)...);
+        probe_type::find(rv != nullptr);
+        return rv;
+    }
+
+    template<typename... PS>
+    exposed_type* find(PS&&... ps)
+    {
+        auto rv = find_at(0, std::forward<PS>(ps)...);
+        probe_type::find(rv != nullptr);
+        return rv;
     }
 
     //------------------------------------------------------------------------------------------------------------------
     // Find the data element as far as possible along the list of prefixes
     //------------------------------------------------------------------------------------------------------------------
-    const DATA* match() const
+    template<typename... PS>
+    const DATA* match(PS&&... ps) const
     {
-        return m_data ? &*m_data : nullptr;
+        size_t depth = 0;
+        auto   rv    = match_at(0, depth, std::forward<PS>(ps)...);
+        probe_type::match(rv != nullptr, depth);
+        return rv;
     }
-    template<typename P, typename... PS>
-    const DATA* match(P&& p, PS&&... ps) const
+
+    template<typename... PS>
+    exposed_type* match(PS&&... ps)
     {
-        auto itr = m_repo.find(std::forward<P>(p));
-        auto rv  = itr != m_repo.end() ? itr->second.match(std::forward<PS>(ps)...) : nullptr;
-        return rv ? rv : match();
+        size_t depth = 0;
+        auto   rv    = match_at(0, depth, std::forward<PS>(ps)...);
+        probe_type::match(rv != nullptr, depth);
+        return rv;
+    }
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Find the data as of time t given the list of prefixes, see versioned_policy. Costs the descent plus a binary search
+    // of the versions at the node. Nodes are kept while they hold versions, so data erased since then is still found.
+    //------------------------------------------------------------------------------------------------------------------
+    template<typename... PS>
+    const DATA* find_as_of(const stamp_type& t, PS&&... ps) const
+    {
+        static_assert(details::is_versioned<store_type>::value, "Node policy does not keep versions");
+        const DATA* rv = nullptr;
+        jump([&](const auto& n) { rv = n.m_data.as_of(t); }, std::forward<PS>(ps)...);
+        return rv;
     }
 
-    DATA* match()
+    //------------------------------------------------------------------------------------------------------------------
+    // Find the data as of time t as far as possible along the list of prefixes
+    //------------------------------------------------------------------------------------------------------------------
+    template<typename... PS>
+    const DATA* match_as_of(const stamp_type& t, PS&&... ps) const
     {
-        return m_data ? &*m_data : nullptr;
+        static_assert(details::is_versioned<store_type>::value, "Node policy does not keep versions");
+        const DATA* rv = nullptr;
+        climb_pre(
+            [&](const auto& n) {
+                if (auto d = n.m_data.as_of(t)) {
+                    rv = d;
+                }
+                return true;
+            },
+            std::forward<PS>(ps)...);
+        return rv;
     }
-    template<typename P, typename... PS>
-    DATA* match(P&& p, PS&&... ps)
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Drop versions that no lookup as of the watermark or later can see and remove the nodes left empty. Returns the
+    // number of dropped versions. Current data is never dropped.
+    //------------------------------------------------------------------------------------------------------------------
+    size_t trim(const stamp_type& watermark)
     {
-        auto itr = m_repo.find(std::forward<P>(p));
-        auto rv  = itr != m_repo.end() ? itr->second.match(std::forward<PS>(ps)...) : nullptr;
-        return rv ? rv : match();
+        static_assert(details::is_versioned<store_type>::value, "Node policy does not keep versions");
+        touch();
+        size_t count = m_data.trim(watermark);
+        for (auto itr = m_repo.begin(); itr != m_repo.end();) {
+            count += itr->second.trim(watermark);
+            itr = itr->second.empty() ? m_repo.erase(itr) : std::next(itr);
+        }
+        return count;
     }
 
     //------------------------------------------------------------------------------------------------------------------
@@ -510,11 +1636,13 @@ public:
     template<typename F>
     void jump(F&& f)
     {
+        touch();
         f(*this);
     }
     template<typename F, typename P, typename... PS>
     void jump(F&& f, P&& p, PS&&... ps)
     {
+        touch();
         auto itr = m_repo.find(std::forward<P>(p));
         if (itr != m_repo.end()) {
             itr->second.jump(std::forward<F>(f), std::forward<PS>(ps)...);
@@ -524,40 +1652,16 @@ public:
     //------------------------------------------------------------------------------------------------------------------
     // Visit all nodes as far as possible along the list of prefixes performing pre and post order operations
     //------------------------------------------------------------------------------------------------------------------
-    template<typename PREF, typename POSF>
-    void climb(PREF&& pref, POSF&& posf) const
-    {
-        pref(*this);
-        posf(*this);
-    }
-    template<typename PREF, typename POSF, typename P, typename... PS>
-    void climb(PREF&& pref, POSF&& posf, P&& p, PS&&... ps) const
+    template<typename PREF, typename POSF, typename... PS>
+    void climb(PREF&& pref, POSF&& posf, PS&&... ps) const
     {
-        if (pref(*this)) {
-            auto itr = m_repo.find(std::forward<P>(p));
-            if (itr != m_repo.end()) {
-                itr->second.climb(std::forward<PREF>(pref), std::forward<POSF>(posf), std::forward<PS>(ps)...);
-            }
-        }
-        posf(*this);
+        probe_type::climb(climb_at(0, std::forward<PREF>(pref), std::forward<POSF>(posf), std::forward<PS>(ps)...));
     }
 
-    template<typename PREF, typename POSF>
-    void climb(PREF&& pref, POSF&& posf)
-    {
-        pref(*this);
-        posf(*this);
-    }
-    template<typename PREF, typename POSF, typename P, typename... PS>
-    void climb(PREF&& pref, POSF&& posf, P&& p, PS&&... ps)
+    template<typename PREF, typename POSF, typename... PS>
+    void climb(PREF&& pref, POSF&& posf, PS&&... ps)
     {
-        if (pref(m_data)) {
-            auto itr = m_repo.find(std::forward<P>(p));
-            if (itr != m_repo.end()) {
-                itr->second.climb(std::forward<PREF>(pref), std::forward<POSF>(posf), std::forward<PS>(ps)...);
-            }
-        }
-        posf(m_data);
+        probe_type::climb(climb_at(0, std::forward<PREF>(pref), std::forward<POSF>(posf), std::forward<PS>(ps)...));
     }
 
     //------------------------------------------------------------------------------------------------------------------
@@ -630,6 +1734,7 @@ public:
     template<typename LEVF>
     void traverse_level(LEVF&& levf)
     {
+        touch();
         for (auto itr = m_repo.begin(); itr != m_repo.end();) {
             auto cur = itr++;
             if (!levf(cur->second, cur->first))
@@ -655,6 +1760,7 @@ public:
     template<typename PREF, typename POSF, typename... PS>
     void traverse_dfs(PREF&& pref, POSF&& posf, PS&&... ps)
     {
+        touch();
         if (pref(*this, std::forward<PS>(ps)...)) {
             for (auto itr = m_repo.begin(); itr != m_repo.end();) {
                 auto cur = itr++;
@@ -695,10 +1801,17 @@ public:
     }
 
     //------------------------------------------------------------------------------------------------------------------
-    // Trie-map equality
+    // Trie-map equality. With hashed_policy different digests reject unequal trie-maps in constant time once the hashes
+    // are cached. Equal digests still compare the whole content, as different trie-maps can collide, so equal trie-maps
+    // cost a full comparison like without the hashes.
     //------------------------------------------------------------------------------------------------------------------
     bool operator==(const this_type& oth) const
     {
+        if constexpr (details::is_hashed<store_type>::value) {
+            if (digest() != oth.digest()) {
+                return false;
+            }
+        }
         return m_data == oth.m_data && m_repo == oth.m_repo;
     }
 
@@ -728,29 +1841,1752 @@ public:
     }
 
 private:
-    std::optional<data_type> m_data;
-    repo_type                m_repo;
-};
+    using probe_type = typename POLICY::probe;
+
+    // Aggregate of the subtree, recomputed from the children if it is stale
+    const aggregate_type& total() const
+    {
+        if constexpr (details::is_aggregated<store_type>::value) {
+            if (m_data.dirty()) {
+                auto t = own();
+                for (const auto& r : m_repo) {
+                    t = monoid_type::combine(t, r.second.total());
+                }
+                m_data.total(std::move(t));
+            }
+            return m_data.total();
+        } else {
+            static const aggregate_type none = monoid_type::identity();
+            return none;
+        }
+    }
 
-} // namespace details
+    template<typename P>
+    aggregate_type total_at(const P& p) const
+    {
+        auto itr = m_repo.find(p);
+        return itr != m_repo.end() ? itr->second.total() : monoid_type::identity();
+    }
 
-//----------------------------------------------------------------------------------------------------------------------
-// Ordered trie-map collection.
-//----------------------------------------------------------------------------------------------------------------------
-template<typename K, typename T>
-using omap = std::map<K, T, std::less<>>;
+    // Aggregate of the data in this node alone
+    aggregate_type own() const
+    {
+        return m_data ? monoid_type::lift(*m_data) : monoid_type::identity();
+    }
 
-template<typename DATA, typename PFIX, typename... PFIXS>
-using otriemap = details::triemap<omap, DATA, PFIX, PFIXS...>;
+    // Run modification f of the part of the subtree whose aggregate is returned by part
+    template<typename PART, typename F>
+    auto modify(PART&& part, F&& f)
+    {
+        return details::modify(m_data, [this] { total(); }, std::forward<PART>(part), std::forward<F>(f));
+    }
 
-//----------------------------------------------------------------------------------------------------------------------
-// Unordered trie-map collection.
-//----------------------------------------------------------------------------------------------------------------------
-template<typename K, typename T>
-using umap = std::unordered_map<K, T>;
+    // Run modification f of the child with key k, which f may create or remove, and move it in the ranking
+    template<typename K, typename PART, typename F>
+    auto modify_at(const K& k, PART&& part, F&& f)
+    {
+        if constexpr (ranked) {
+            if (!rank().stale()) {
+                auto before = rank().score(child_at(k));
+                auto rv     = modify(std::forward<PART>(part), std::forward<F>(f));
+                rank().replace(k, before, rank().score(child_at(k)));
+                return rv;
+            }
+        }
+        return modify(std::forward<PART>(part), std::forward<F>(f));
+    }
+
+    // Mark cached aggregates, hashes and ranking stale before non-const access
+    void touch()
+    {
+        details::touch(m_data);
+        if constexpr (ranked) {
+            rank().touch();
+        }
+    }
+
+    static constexpr bool ranked = !std::is_same_v<rank_type, details::no_ranking>;
+
+    // Check if insert of D given the list of prefixes grafts a node handle
+    template<typename D, typename P, typename... PS>
+    static constexpr bool grafts()
+    {
+        if constexpr (sizeof...(PS) == 0) {
+            return std::is_same_v<std::decay_t<D>, node_type>;
+        } else {
+            return child_type::template grafts<D, PS...>();
+        }
+    }
+
+    static_assert(details::fanout_hint<POLICY>::levels == 0 || details::fanout_hint<POLICY>::levels > sizeof...(PFIXS),
+                  "Fan-out hints must name every prefix level");
+    static constexpr size_t hint = details::fanout_hint<POLICY>::at(sizeof...(PFIXS) + 1);
+
+    template<typename P, typename... PS>
+    void reserve_at(size_t n, P&& p, PS&&... ps)
+    {
+        child(std::forward<P>(p)).reserve(n, std::forward<PS>(ps)...);
+    }
+
+    // Relocation leaves the content as it is, so the path is not touched
+    template<bool DEEP, typename P, typename... PS>
+    size_t relocate_at(P&& p, PS&&... ps)
+    {
+        auto itr = m_repo.find(std::forward<P>(p));
+        if (itr == m_repo.end()) {
+            return 0;
+        }
+        if constexpr (DEEP) {
+            return itr->second.compact(std::forward<PS>(ps)...);
+        } else {
+            return itr->second.shrink_to_fit(std::forward<PS>(ps)...);
+        }
+    }
+
+    rank_type& rank()
+    {
+        return *this;
+    }
+    const rank_type& rank() const
+    {
+        return *this;
+    }
+
+    template<typename K>
+    const child_type* child_at(const K& k) const
+    {
+        auto itr = m_repo.find(k);
+        return itr != m_repo.end() ? &itr->second : nullptr;
+    }
+
+    template<typename F>
+    void top_at(F& f, size_t k) const
+    {
+        for (const auto& e : rank().order(m_repo)) {
+            if (k-- == 0) {
+                break;
+            }
+            auto itr = m_repo.find(e.second);
+            if (!f(itr->second, itr->first)) {
+                break;
+            }
+        }
+    }
+    template<typename F, typename P, typename... PS>
+    void top_at(F& f, size_t k, P&& p, PS&&... ps) const
+    {
+        auto itr = m_repo.find(std::forward<P>(p));
+        if (itr != m_repo.end()) {
+            itr->second.top_at(f, k, std::forward<PS>(ps)...);
+        }
+    }
+
+    const aggregate_type* aggregate_at() const
+    {
+        return &total();
+    }
+    template<typename P, typename... PS>
+    const aggregate_type* aggregate_at(P&& p, PS&&... ps) const
+    {
+        auto itr = m_repo.find(std::forward<P>(p));
+        return itr != m_repo.end() ? itr->second.aggregate_at(std::forward<PS>(ps)...) : nullptr;
+    }
+
+    // Lookup helpers that keep track of the distance from the node where the lookup started
+    const DATA* find_at(size_t) const
+    {
+        return m_data ? &*m_data : nullptr;
+    }
+    template<typename P, typename... PS>
+    const DATA* find_at(size_t level, P&& p, PS&&... ps) const
+    {
+        probe_type::probe(level);
+        auto itr = m_repo.find(std::forward<P>(p));
+        return itr != m_repo.end() ? itr->second.find_at(level + 1, std::forward<PS>(ps)...) : nullptr;
+    }
+
+    exposed_type* find_at(size_t)
+    {
+        touch();
+        return m_data ? &*m_data : nullptr;
+    }
+    template<typename P, typename... PS>
+    exposed_type* find_at(size_t level, P&& p, PS&&... ps)
+    {
+        touch();
+        probe_type::probe(level);
+        auto itr = m_repo.find(std::forward<P>(p));
+        return itr != m_repo.end() ? itr->second.find_at(level + 1, std::forward<PS>(ps)...) : nullptr;
+    }
+
+    const DATA* match_at(size_t level, size_t& depth) const
+    {
+        depth = level;
+        return m_data ? &*m_data : nullptr;
+    }
+    template<typename P, typename... PS>
+    const DATA* match_at(size_t level, size_t& depth, P&& p, PS&&... ps) const
+    {
+        probe_type::probe(level);
+        auto itr = m_repo.find(std::forward<P>(p));
+        auto rv  = itr != m_repo.end() ? itr->second.match_at(level + 1, depth, std::forward<PS>(ps)...) : nullptr;
+        return rv ? rv : match_at(level, depth);
+    }
+
+    exposed_type* match_at(size_t level, size_t& depth)
+    {
+        touch();
+        depth = level;
+        return m_data ? &*m_data : nullptr;
+    }
+    template<typename P, typename... PS>
+    exposed_type* match_at(size_t level, size_t& depth, P&& p, PS&&... ps)
+    {
+        touch();
+        probe_type::probe(level);
+        auto itr = m_repo.find(std::forward<P>(p));
+        auto rv  = itr != m_repo.end() ? itr->second.match_at(level + 1, depth, std::forward<PS>(ps)...) : nullptr;
+        return rv ? rv : match_at(level, depth);
+    }
+
+    // Climb helpers return the number of visited nodes
+    template<typename PREF, typename POSF>
+    size_t climb_at(size_t, PREF&& pref, POSF&& posf) const
+    {
+        pref(*this);
+        posf(*this);
+        return 1;
+    }
+    template<typename PREF, typename POSF, typename P, typename... PS>
+    size_t climb_at(size_t level, PREF&& pref, POSF&& posf, P&& p, PS&&... ps) const
+    {
+        size_t length = 1;
+        if (pref(*this)) {
+            probe_type::probe(level);
+            auto itr = m_repo.find(std::forward<P>(p));
+            if (itr != m_repo.end()) {
+                length += itr->second.climb_at(
+                    level + 1, std::forward<PREF>(pref), std::forward<POSF>(posf), std::forward<PS>(ps)...);
+            }
+        }
+        posf(*this);
+        return length;
+    }
+
+    template<typename PREF, typename POSF>
+    size_t climb_at(size_t, PREF&& pref, POSF&& posf)
+    {
+        touch();
+        pref(*this);
+        posf(*this);
+        return 1;
+    }
+    template<typename PREF, typename POSF, typename P, typename... PS>
+    size_t climb_at(size_t level, PREF&& pref, POSF&& posf, P&& p, PS&&... ps)
+    {
+        touch();
+        size_t length = 1;
+        if (pref(m_data)) {
+            probe_type::probe(level);
+            auto itr = m_repo.find(std::forward<P>(p));
+            if (itr != m_repo.end()) {
+                length += itr->second.climb_at(
+                    level + 1, std::forward<PREF>(pref), std::forward<POSF>(posf), std::forward<PS>(ps)...);
+            }
+        }
+        posf(m_data);
+        return length;
+    }
+
+    // Accumulate statistics of the subtree
+    void collect(statistics& st, size_t level) const
+    {
+        if (st.levels.size() <= level) {
+            st.levels.resize(level + 1);
+        }
+        auto& lv = st.levels[level];
+        lv.nodes += 1;
+        lv.data += m_data ? 1 : 0;
+        lv.fanout[m_repo.size()] += 1;
+        st.data_bytes += footprint<store_type>::bytes(m_data);
+        st.allocations += footprint<store_type>::allocations(m_data);
+        st.repo_bytes += footprint<repo_type>::bytes(m_repo);
+        st.allocations += footprint<repo_type>::allocations(m_repo);
+
+        for (const auto& r : m_repo) {
+            r.second.collect(st, level + 1);
+        }
+    }
+
+    store_type m_data;
+    repo_type  m_repo;
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+// Out-of-line data store. Holds a pointer to separately allocated data; null pointer means no data. It mirrors the
+// subset of std::optional interface used by the trie-map nodes.
+//----------------------------------------------------------------------------------------------------------------------
+template<typename DATA, typename ALLOC = std::allocator<DATA>>
+class boxed : private ALLOC
+{
+    using traits = std::allocator_traits<ALLOC>;
+
+    DATA* m_data = nullptr;
+
+    template<typename... AS>
+    DATA* make(AS&&... as)
+    {
+        ALLOC& alloc = *this;
+        DATA*  data  = traits::allocate(alloc, 1);
+        try {
+            traits::construct(alloc, data, std::forward<AS>(as)...);
+        } catch (...) {
+            traits::deallocate(alloc, data, 1);
+            throw;
+        }
+        return data;
+    }
+
+public:
+    using value_type = DATA;
+
+    boxed() = default;
+
+    boxed(const boxed& oth)
+      : ALLOC(oth)
+      , m_data(oth ? make(*oth) : nullptr)
+    {}
+
+    boxed(boxed&& oth) noexcept
+      : ALLOC(std::move(oth))
+      , m_data(std::exchange(oth.m_data, nullptr))
+    {}
+
+    ~boxed()
+    {
+        reset();
+    }
+
+    boxed& operator=(const boxed& oth)
+    {
+        if (this != &oth) {
+            if (oth) {
+                *this = *oth;
+            } else {
+                reset();
+            }
+        }
+        return *this;
+    }
+
+    boxed& operator=(boxed&& oth) noexcept
+    {
+        if (this != &oth) {
+            reset();
+            m_data = std::exchange(oth.m_data, nullptr);
+        }
+        return *this;
+    }
+
+    template<typename D, typename = std::enable_if_t<!std::is_same_v<std::decay_t<D>, boxed>>>
+    boxed& operator=(D&& data)
+    {
+        if (m_data) {
+            *m_data = std::forward<D>(data);
+        } else {
+            m_data = make(std::forward<D>(data));
+        }
+        return *this;
+    }
+
+    template<typename... AS>
+    DATA& emplace(AS&&... as)
+    {
+        reset();
+        m_data = make(std::forward<AS>(as)...);
+        return *m_data;
+    }
+
+    void reset()
+    {
+        if (m_data) {
+            ALLOC& alloc = *this;
+            traits::destroy(alloc, m_data);
+            traits::deallocate(alloc, m_data, 1);
+            m_data = nullptr;
+        }
+    }
+
+    [[nodiscard]] bool has_value() const
+    {
+        return m_data != nullptr;
+    }
+    explicit operator bool() const
+    {
+        return m_data != nullptr;
+    }
+
+    const DATA& operator*() const
+    {
+        return *m_data;
+    }
+    DATA& operator*()
+    {
+        return *m_data;
+    }
+
+    const DATA* operator->() const
+    {
+        return m_data;
+    }
+    DATA* operator->()
+    {
+        return m_data;
+    }
+
+    // Empty store compares equal to another empty store and less than any store with data
+    bool operator==(const boxed& oth) const
+    {
+        return m_data && oth.m_data ? *m_data == *oth.m_data : m_data == oth.m_data;
+    }
+    bool operator!=(const boxed& oth) const
+    {
+        return !(*this == oth);
+    }
+    bool operator<(const boxed& oth) const
+    {
+        return m_data && oth.m_data ? *m_data < *oth.m_data : !m_data && oth.m_data;
+    }
+};
+
+// Out-of-line data store
+template<typename D, typename A>
+struct footprint<boxed<D, A>>
+{
+    static size_t bytes(const boxed<D, A>& b)
+    {
+        return b ? sizeof(D) : 0;
+    }
+    static size_t allocations(const boxed<D, A>& b)
+    {
+        return b ? 1 : 0;
+    }
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+// Data store with a cached subtree hash. Wraps another store and adds the hash together with a flag telling whether it
+// is stale. The cache is updated from const member functions, so concurrent readers must not compute hashes of the same
+// trie-map unless it was hashed after the last modification.
+//----------------------------------------------------------------------------------------------------------------------
+template<typename STORE>
+class hashed
+{
+    STORE            m_store;
+    mutable uint64_t m_hash  = 0;
+    mutable bool     m_dirty = true;
+
+public:
+    hashed() = default;
+
+    template<typename D, typename = std::enable_if_t<!std::is_same_v<std::decay_t<D>, hashed>>>
+    hashed& operator=(D&& data)
+    {
+        m_store = std::forward<D>(data);
+        m_dirty = true;
+        return *this;
+    }
+
+    void reset()
+    {
+        m_store.reset();
+        m_dirty = true;
+    }
+
+    [[nodiscard]] bool has_value() const
+    {
+        return m_store.has_value();
+    }
+
+    explicit operator bool() const
+    {
+        return has_value();
+    }
+
+    decltype(auto) operator*() const
+    {
+        return *m_store;
+    }
+    decltype(auto) operator*()
+    {
+        return *m_store;
+    }
+
+    auto operator->() const
+    {
+        return &*m_store;
+    }
+    auto operator->()
+    {
+        return &*m_store;
+    }
+
+    bool operator==(const hashed& oth) const
+    {
+        return m_store == oth.m_store;
+    }
+    bool operator!=(const hashed& oth) const
+    {
+        return !(*this == oth);
+    }
+    bool operator<(const hashed& oth) const
+    {
+        return m_store < oth.m_store;
+    }
+
+    // Wrapped store
+    const STORE& base() const
+    {
+        return m_store;
+    }
+
+    // Cache management used by the trie-map nodes
+    void touch()
+    {
+        m_dirty = true;
+    }
+    [[nodiscard]] bool dirty() const
+    {
+        return m_dirty;
+    }
+    [[nodiscard]] uint64_t cached() const
+    {
+        return m_hash;
+    }
+    void cache(uint64_t h) const
+    {
+        m_hash  = h;
+        m_dirty = false;
+    }
+};
+
+template<typename S>
+struct footprint<hashed<S>>
+{
+    static size_t bytes(const hashed<S>& h)
+    {
+        return footprint<S>::bytes(h.base());
+    }
+    static size_t allocations(const hashed<S>& h)
+    {
+        return footprint<S>::allocations(h.base());
+    }
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+// Data store with the aggregate of its subtree. Wraps another store and adds the aggregate together with a flag telling
+// whether it is stale. Like the hash cache, a stale aggregate is recomputed from const member functions. Lazy aggregates
+// are only marked stale by modifications and wait for the next read.
+//----------------------------------------------------------------------------------------------------------------------
+template<typename STORE, typename MONOID, bool LAZY = false>
+class aggregated
+{
+    STORE                               m_store;
+    mutable typename MONOID::value_type m_total = MONOID::identity();
+    mutable bool                        m_dirty = false;
+
+public:
+    using monoid_type = MONOID;
+    using value_type  = typename MONOID::value_type;
+
+    static constexpr bool lazy = LAZY;
+
+    aggregated() = default;
+
+    template<typename D, typename = std::enable_if_t<!std::is_same_v<std::decay_t<D>, aggregated>>>
+    aggregated& operator=(D&& data)
+    {
+        m_store = std::forward<D>(data);
+        m_dirty = true;
+        return *this;
+    }
+
+    void reset()
+    {
+        m_store.reset();
+        m_dirty = true;
+    }
+
+    [[nodiscard]] bool has_value() const
+    {
+        return m_store.has_value();
+    }
+
+    explicit operator bool() const
+    {
+        return has_value();
+    }
+
+    decltype(auto) operator*() const
+    {
+        return *m_store;
+    }
+    decltype(auto) operator*()
+    {
+        return *m_store;
+    }
+
+    auto operator->() const
+    {
+        return &*m_store;
+    }
+    auto operator->()
+    {
+        return &*m_store;
+    }
+
+    bool operator==(const aggregated& oth) const
+    {
+        return m_store == oth.m_store;
+    }
+    bool operator!=(const aggregated& oth) const
+    {
+        return !(*this == oth);
+    }
+    bool operator<(const aggregated& oth) const
+    {
+        return m_store < oth.m_store;
+    }
+
+    // Wrapped store
+    const STORE& base() const
+    {
+        return m_store;
+    }
+
+    // Aggregate management used by the trie-map nodes
+    void touch()
+    {
+        m_dirty = true;
+    }
+    [[nodiscard]] bool dirty() const
+    {
+        return m_dirty;
+    }
+    [[nodiscard]] const value_type& total() const
+    {
+        return m_total;
+    }
+    void total(value_type v) const
+    {
+        m_total = std::move(v);
+        m_dirty = false;
+    }
+};
+
+template<typename S, typename M, bool L>
+struct footprint<aggregated<S, M, L>>
+{
+    static size_t bytes(const aggregated<S, M, L>& a)
+    {
+        return footprint<S>::bytes(a.base());
+    }
+    static size_t allocations(const aggregated<S, M, L>& a)
+    {
+        return footprint<S>::allocations(a.base());
+    }
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+// Data store with a chain of versions. Every modification adds a version stamped by CLOCK, oldest first, and erasing the
+// data adds an empty one. Modifications within one stamp replace the last version. The data of the last version is the
+// current data seen through the std::optional interface, and earlier versions are only read by as_of.
+//----------------------------------------------------------------------------------------------------------------------
+template<typename DATA, typename CLOCK>
+class versioned
+{
+public:
+    using value_type = DATA;
+    using stamp_type = std::decay_t<std::invoke_result_t<const CLOCK&>>;
+
+private:
+    using version_type = std::pair<stamp_type, std::optional<DATA>>;
+
+    std::vector<version_type> m_chain;
+
+    // Data of the version at the current stamp, added if the last version is older
+    std::optional<DATA>& stamp()
+    {
+        auto now = CLOCK()();
+        if (m_chain.empty() || m_chain.back().first < now) {
+            m_chain.emplace_back(std::move(now), std::nullopt);
+        }
+        return m_chain.back().second;
+    }
+
+    // First version stamped after t
+    auto after(const stamp_type& t) const
+    {
+        return std::upper_bound(
+            m_chain.begin(), m_chain.end(), t, [](const stamp_type& a, const version_type& v) { return a < v.first; });
+    }
+
+public:
+    versioned() = default;
+
+    template<typename D, typename = std::enable_if_t<!std::is_same_v<std::decay_t<D>, versioned>>>
+    versioned& operator=(D&& data)
+    {
+        stamp() = std::forward<D>(data);
+        return *this;
+    }
+
+    void reset()
+    {
+        if (has_value()) {
+            stamp().reset();
+        }
+    }
+
+    [[nodiscard]] bool has_value() const
+    {
+        return !m_chain.empty() && m_chain.back().second.has_value();
+    }
+
+    explicit operator bool() const
+    {
+        return has_value();
+    }
+
+    const DATA& operator*() const
+    {
+        return *m_chain.back().second;
+    }
+    DATA& operator*()
+    {
+        return *m_chain.back().second;
+    }
+
+    const DATA* operator->() const
+    {
+        return &**this;
+    }
+    DATA* operator->()
+    {
+        return &**this;
+    }
+
+    bool operator==(const versioned& oth) const
+    {
+        return has_value() && oth.has_value() ? **this == *oth : has_value() == oth.has_value();
+    }
+    bool operator!=(const versioned& oth) const
+    {
+        return !(*this == oth);
+    }
+    bool operator<(const versioned& oth) const
+    {
+        return has_value() && oth.has_value() ? **this < *oth : !has_value() && oth.has_value();
+    }
+
+    // Current data about to be modified in place, copied into a new version unless the last one has the current stamp
+    DATA& revise()
+    {
+        auto& last = stamp();
+        if (!last) {
+            last = m_chain[m_chain.size() - 2].second;
+        }
+        return *last;
+    }
+
+    // Data as of time t, null if there was none
+    const DATA* as_of(const stamp_type& t) const
+    {
+        auto itr = after(t);
+        return itr != m_chain.begin() && std::prev(itr)->second ? &*std::prev(itr)->second : nullptr;
+    }
+
+    // Drop versions that nothing as of time t or later can see, return their number
+    size_t trim(const stamp_type& t)
+    {
+        auto   itr  = after(t);
+        size_t keep = itr != m_chain.begin() && std::prev(itr)->second ? 1 : 0;
+        size_t gone = static_cast<size_t>(itr - m_chain.begin()) - keep;
+        m_chain.erase(m_chain.begin(), m_chain.begin() + gone);
+        if (m_chain.empty()) {
+            m_chain.shrink_to_fit();
+        }
+        return gone;
+    }
+
+    [[nodiscard]] size_t versions() const
+    {
+        return m_chain.size();
+    }
+    [[nodiscard]] size_t capacity() const
+    {
+        return m_chain.capacity();
+    }
+};
+
+// Chain of versions in one allocation
+template<typename D, typename C>
+struct footprint<versioned<D, C>>
+{
+    static size_t bytes(const versioned<D, C>& v)
+    {
+        return v.capacity() * sizeof(std::pair<typename versioned<D, C>::stamp_type, std::optional<D>>);
+    }
+    static size_t allocations(const versioned<D, C>& v)
+    {
+        return v.capacity() > 0 ? 1 : 0;
+    }
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+// Path-compressed children container. A lone child is stored inline together with its key, so a run of single-child
+// nodes is kept in one allocation and is descended with a key comparison instead of a map probe. The container expands
+// into the underlying map when a sibling is inserted, and collapses back when erase or extract leaves one child. Both
+// move the lone child, so unlike with the underlying map, pointers and references to it and to any node or data in its
+// subtree are invalidated, and so are iterators to the container.
+//----------------------------------------------------------------------------------------------------------------------
+template<template<typename K, typename T> class MAP, typename KEY, typename T>
+class chain_map
+{
+public:
+    using many_type   = MAP<KEY, T>;
+    using key_type    = KEY;
+    using mapped_type = T;
+    using value_type  = std::pair<const KEY, T>;
+    using size_type   = std::size_t;
+    using node_type   = typename many_type::node_type;
+
+private:
+    using repo_type = std::variant<std::monostate, value_type, many_type>;
+
+    enum : std::size_t
+    {
+        none,
+        solo,
+        many
+    };
+
+    template<typename M, typename = void>
+    struct ordered : std::false_type
+    {};
+    template<typename M>
+    struct ordered<M, std::void_t<typename M::key_compare>> : std::true_type
+    {};
+
+    // Compare keys using the same notion of equivalence as the underlying map
+    template<typename Q>
+    static bool same(const KEY& k, const Q& q)
+    {
+        if constexpr (ordered<many_type>::value) {
+            typename many_type::key_compare c;
+            return !c(k, q) && !c(q, k);
+        } else {
+            return typename many_type::key_equal()(k, q);
+        }
+    }
+
+    template<typename V, typename I>
+    class basic_iterator
+    {
+        friend class chain_map;
+
+        V* m_solo = nullptr;
+        I  m_many = I();
+
+        explicit basic_iterator(V* solo)
+          : m_solo(solo)
+        {}
+        explicit basic_iterator(I many)
+          : m_many(many)
+        {}
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type        = typename chain_map::value_type;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = V*;
+        using reference         = V&;
+
+        basic_iterator() = default;
+
+        V& operator*() const
+        {
+            return m_solo ? *m_solo : *m_many;
+        }
+        V* operator->() const
+        {
+            return m_solo ? m_solo : &*m_many;
+        }
+
+        basic_iterator& operator++()
+        {
+            if (m_solo) {
+                m_solo = nullptr;
+            } else {
+                ++m_many;
+            }
+            return *this;
+        }
+        basic_iterator operator++(int)
+        {
+            auto tmp = *this;
+            ++*this;
+            return tmp;
+        }
+
+        bool operator==(const basic_iterator& oth) const
+        {
+            return m_solo == oth.m_solo && m_many == oth.m_many;
+        }
+        bool operator!=(const basic_iterator& oth) const
+        {
+            return !(*this == oth);
+        }
+    };
+
+public:
+    using iterator       = basic_iterator<value_type, typename many_type::iterator>;
+    using const_iterator = basic_iterator<const value_type, typename many_type::const_iterator>;
+
+    chain_map() = default;
+
+    chain_map(const chain_map& oth)
+      : m_repo(oth.m_repo)
+    {}
+
+    // An inline element moves with its key copied, so moves cannot throw if neither the key copy nor the map move can
+    chain_map(chain_map&& oth) noexcept(std::is_nothrow_move_constructible_v<repo_type>)
+      : m_repo(std::move(oth.m_repo))
+    {}
+
+    chain_map& operator=(const chain_map& oth)
+    {
+        if (this != &oth) {
+            assign(oth.m_repo);
+        }
+        return *this;
+    }
+
+    chain_map& operator=(chain_map&& oth) noexcept(std::is_nothrow_move_constructible_v<repo_type>)
+    {
+        if (this != &oth) {
+            assign(std::move(oth.m_repo));
+        }
+        return *this;
+    }
+
+    iterator begin()
+    {
+        switch (m_repo.index()) {
+            case solo:
+                return iterator(&std::get<solo>(m_repo));
+            case many:
+                return iterator(std::get<many>(m_repo).begin());
+        }
+        return iterator();
+    }
+    iterator end()
+    {
+        return m_repo.index() == many ? iterator(std::get<many>(m_repo).end()) : iterator();
+    }
+
+    const_iterator begin() const
+    {
+        switch (m_repo.index()) {
+            case solo:
+                return const_iterator(&std::get<solo>(m_repo));
+            case many:
+                return const_iterator(std::get<many>(m_repo).begin());
+        }
+        return const_iterator();
+    }
+    const_iterator end() const
+    {
+        return m_repo.index() == many ? const_iterator(std::get<many>(m_repo).end()) : const_iterator();
+    }
+
+    [[nodiscard]] bool empty() const
+    {
+        return size() == 0;
+    }
+
+    [[nodiscard]] size_type size() const
+    {
+        switch (m_repo.index()) {
+            case solo:
+                return 1;
+            case many:
+                return std::get<many>(m_repo).size();
+        }
+        return 0;
+    }
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Return true if the children are stored inline
+    //------------------------------------------------------------------------------------------------------------------
+    [[nodiscard]] bool inlined() const
+    {
+        return m_repo.index() != many;
+    }
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Access underlying map of expanded container
+    //------------------------------------------------------------------------------------------------------------------
+    const many_type& expanded() const
+    {
+        return std::get<many>(m_repo);
+    }
+
+    template<typename Q>
+    iterator find(const Q& q)
+    {
+        switch (m_repo.index()) {
+            case solo:
+                return same(std::get<solo>(m_repo).first, q) ? begin() : end();
+            case many:
+                return iterator(std::get<many>(m_repo).find(q));
+        }
+        return end();
+    }
+
+    template<typename Q>
+    const_iterator find(const Q& q) const
+    {
+        switch (m_repo.index()) {
+            case solo:
+                return same(std::get<solo>(m_repo).first, q) ? begin() : end();
+            case many:
+                return const_iterator(std::get<many>(m_repo).find(q));
+        }
+        return end();
+    }
+
+    T& operator[](const KEY& k)
+    {
+        return emplace(k);
+    }
+    T& operator[](KEY&& k)
+    {
+        return emplace(std::move(k));
+    }
+
+    // Find or insert an element that does not order before existing ones, see details::append
+    template<typename K>
+    T& append(K&& k)
+    {
+        if (m_repo.index() != many) {
+            return emplace(std::forward<K>(k));
+        }
+        return details::append(std::get<many>(m_repo), std::forward<K>(k));
+    }
+
+    // Expand ahead of time when more than one child is expected
+    void reserve(size_type n)
+    {
+        if (n < 2) {
+            return;
+        }
+        if (m_repo.index() == solo) {
+            expand();
+        } else if (m_repo.index() == none) {
+            m_repo.template emplace<many>();
+        }
+        details::reserve(std::get<many>(m_repo), n);
+    }
+
+    // Relocate the underlying map, moving a single element back inline
+    void compact()
+    {
+        if (m_repo.index() != many) {
+            return;
+        }
+        if (std::get<many>(m_repo).size() < 2) {
+            collapse();
+        } else {
+            details::relocate(std::get<many>(m_repo));
+        }
+    }
+
+    // Erase element, moving the last one left back inline
+    iterator erase(iterator itr)
+    {
+        if (m_repo.index() == solo) {
+            m_repo.template emplace<none>();
+            return end();
+        }
+        auto next = std::get<many>(m_repo).erase(itr.m_many);
+        if (std::get<many>(m_repo).size() > 1) {
+            return iterator(next);
+        }
+        bool last = next == std::get<many>(m_repo).end();
+        collapse();
+        return last ? end() : begin();
+    }
+
+    template<typename Q>
+    size_type erase(const Q& q)
+    {
+        auto itr = find(q);
+        if (itr == end()) {
+            return 0;
+        }
+        erase(itr);
+        return 1;
+    }
+
+    void clear()
+    {
+        m_repo.template emplace<none>();
+    }
+
+    // Detach element into a node handle of the underlying map, an inline element is moved into a new node first
+    template<typename Q>
+    node_type extract(const Q& q)
+    {
+        switch (m_repo.index()) {
+            case none:
+                return node_type();
+            case solo:
+                if (!same(std::get<solo>(m_repo).first, q)) {
+                    return node_type();
+                }
+                expand();
+                break;
+        }
+        auto nh = std::get<many>(m_repo).extract(q);
+        if (std::get<many>(m_repo).size() < 2) {
+            collapse();
+        }
+        return nh;
+    }
+
+    struct insert_return_type
+    {
+        iterator  position;
+        bool      inserted;
+        node_type node;
+    };
+
+    // Insert node handle. Into an empty container the element is moved inline and the node is released.
+    insert_return_type insert(node_type&& nh)
+    {
+        if (nh.empty()) {
+            return { end(), false, node_type() };
+        }
+        switch (m_repo.index()) {
+            case none:
+                m_repo.template emplace<solo>(std::move(nh.key()), std::move(nh.mapped()));
+                nh = node_type();
+                return { begin(), true, node_type() };
+            case solo:
+                if (same(std::get<solo>(m_repo).first, nh.key())) {
+                    return { begin(), false, std::move(nh) };
+                }
+                expand();
+                break;
+        }
+        auto rv = std::get<many>(m_repo).insert(std::move(nh));
+        return { iterator(rv.position), rv.inserted, std::move(rv.node) };
+    }
+
+    // Move elements with keys not present here from the other container, leaving the rest in it
+    void merge(chain_map& oth)
+    {
+        switch (oth.m_repo.index()) {
+            case none:
+                return;
+            case solo:
+                if (find(std::get<solo>(oth.m_repo).first) == end()) {
+                    emplace(std::get<solo>(oth.m_repo).first) = std::move(std::get<solo>(oth.m_repo).second);
+                    oth.clear();
+                }
+                return;
+        }
+        switch (m_repo.index()) {
+            case none:
+                assign(std::move(oth.m_repo));
+                oth.clear();
+                return;
+            case solo:
+                expand();
+                break;
+        }
+        std::get<many>(m_repo).merge(std::get<many>(oth.m_repo));
+    }
+
+    bool operator==(const chain_map& oth) const
+    {
+        if (m_repo.index() == many && oth.m_repo.index() == many) {
+            return std::get<many>(m_repo) == std::get<many>(oth.m_repo);
+        }
+        if (size() != oth.size()) {
+            return false;
+        }
+        return std::all_of(begin(), end(), [&](const value_type& v) {
+            auto itr = oth.find(v.first);
+            return itr != oth.end() && itr->second == v.second;
+        });
+    }
+    bool operator!=(const chain_map& oth) const
+    {
+        return !(*this == oth);
+    }
+
+private:
+    // Find or insert an element, expanding inline child into the underlying map on collision
+    template<typename K>
+    T& emplace(K&& k)
+    {
+        switch (m_repo.index()) {
+            case none:
+                return m_repo.template emplace<solo>(std::piecewise_construct,
+                                                     std::forward_as_tuple(std::forward<K>(k)),
+                                                     std::forward_as_tuple())
+                    .second;
+            case solo:
+                if (same(std::get<solo>(m_repo).first, k)) {
+                    return std::get<solo>(m_repo).second;
+                }
+                expand();
+                break;
+        }
+        return std::get<many>(m_repo)[std::forward<K>(k)];
+    }
+
+    // Move a single element of the underlying map back inline, or drop the empty map
+    void collapse()
+    {
+        auto& repo = std::get<many>(m_repo);
+        if (repo.empty()) {
+            m_repo.template emplace<none>();
+        } else {
+            value_type v(repo.begin()->first, std::move(repo.begin()->second));
+            m_repo.template emplace<solo>(std::move(v));
+        }
+    }
+
+    void expand()
+    {
+        many_type repo;
+        repo.emplace(std::move(std::get<solo>(m_repo)));
+        m_repo.template emplace<many>(std::move(repo));
+    }
+
+    template<typename R>
+    void assign(R&& repo)
+    {
+        switch (repo.index()) {
+            case none:
+                m_repo.template emplace<none>();
+                break;
+            case solo:
+                m_repo.template emplace<solo>(std::get<solo>(std::forward<R>(repo)));
+                break;
+            case many:
+                m_repo.template emplace<many>(std::get<many>(std::forward<R>(repo)));
+                break;
+        }
+    }
+
+    repo_type m_repo;
+};
+
+// Inline child of path-compressed container is part of the parent node
+template<template<typename K, typename T> class MAP, typename KEY, typename T>
+struct footprint<chain_map<MAP, KEY, T>>
+{
+    static size_t bytes(const chain_map<MAP, KEY, T>& c)
+    {
+        return c.inlined() ? 0 : footprint<typename chain_map<MAP, KEY, T>::many_type>::bytes(c.expanded());
+    }
+    static size_t allocations(const chain_map<MAP, KEY, T>& c)
+    {
+        return c.inlined() ? 0 : footprint<typename chain_map<MAP, KEY, T>::many_type>::allocations(c.expanded());
+    }
+};
+
+// Prefix types of the levels below a node
+template<typename TM>
+struct prefixes_of;
+
+template<template<typename K, typename T> class MAP, typename POLICY, typename DATA, typename... PFIXS>
+struct prefixes_of<triemap<MAP, POLICY, DATA, PFIXS...>>
+{
+    using type = std::tuple<PFIXS...>;
+};
+
+// Key path kept outside of a trie-map, as the number of prefixes and the prefixes with the trailing ones defaulted.
+// Wrappers that track data by where it lives hold key paths rather than node pointers, since these stay valid when
+// nodes move, as on compact. Paths compare equal when they name the same node.
+template<typename KEYS>
+struct key_path
+{
+    using type = std::pair<size_t, KEYS>;
+
+    static constexpr size_t levels = std::tuple_size_v<KEYS>;
+
+    template<typename... PS>
+    static type make(const PS&... ps)
+    {
+        static_assert(sizeof...(PS) <= levels, "Too many prefixes");
+        type path;
+        path.first = sizeof...(PS);
+        assign(path.second, std::make_index_sequence<sizeof...(PS)>(), ps...);
+        return path;
+    }
+
+    // Reset the prefixes past the depth, for paths that reuse one tuple
+    template<size_t D = 0>
+    static void clear_trailing(type& path)
+    {
+        if constexpr (D < levels) {
+            if (D >= path.first) {
+                std::get<D>(path.second) = std::tuple_element_t<D, KEYS>();
+            }
+            clear_trailing<D + 1>(path);
+        }
+    }
+
+    // Return f called with the prefixes of the path in order
+    template<size_t D = 0, typename F>
+    static auto call(const type& path, F&& f)
+    {
+        if constexpr (D < levels) {
+            if (path.first != D) {
+                return call<D + 1>(path, f);
+            }
+        }
+        return invoke(path.second, f, std::make_index_sequence<D>());
+    }
+
+private:
+    template<size_t... I, typename... PS>
+    static void assign(KEYS& keys, std::index_sequence<I...>, const PS&... ps)
+    {
+        ((std::get<I>(keys) = ps), ...);
+    }
+
+    template<typename F, size_t... I>
+    static auto invoke(const KEYS& keys, F& f, std::index_sequence<I...>)
+    {
+        return f(std::get<I>(keys)...);
+    }
+};
+
+// Node type L levels below a node
+template<typename TM, size_t L>
+struct node_at
+{
+    using type = typename node_at<typename TM::child_type, L - 1>::type;
+};
+
+template<typename TM>
+struct node_at<TM, 0>
+{
+    using type = TM;
+};
+
+} // namespace details
+
+//----------------------------------------------------------------------------------------------------------------------
+// Lookup instrumentation that does nothing. It is the default and compiles away entirely.
+//----------------------------------------------------------------------------------------------------------------------
+struct null_probe
+{
+    static void find(bool) {}
+    static void match(bool, size_t) {}
+    static void climb(size_t) {}
+    static void probe(size_t) {}
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+// Snapshot of lookup counters. Levels are relative to the node where the lookup started, deeper levels are folded into
+// the last slot.
+//----------------------------------------------------------------------------------------------------------------------
+struct probe_snapshot
+{
+    static constexpr size_t levels = 16;
+
+    uint64_t finds        = 0; // Number of find calls
+    uint64_t find_misses  = 0; // Number of find calls that returned no data
+    uint64_t matches      = 0; // Number of match calls
+    uint64_t match_misses = 0; // Number of match calls that returned no data
+    uint64_t climbs       = 0; // Number of climb calls
+    uint64_t climb_nodes  = 0; // Number of nodes visited by climb calls
+
+    std::array<uint64_t, levels> match_depth{}; // Matches by the level of the node that supplied the data
+    std::array<uint64_t, levels> climb_length{}; // Climbs by the number of visited nodes
+    std::array<uint64_t, levels> probes{}; // Child container lookups by level
+
+    [[nodiscard]] uint64_t lookups() const
+    {
+        return finds + matches;
+    }
+
+    [[nodiscard]] uint64_t misses() const
+    {
+        return find_misses + match_misses;
+    }
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+// Lookup instrumentation that counts events in relaxed atomic counters. Counters are shared by all trie-maps using the
+// same TAG and can be scraped at any time with snapshot.
+//----------------------------------------------------------------------------------------------------------------------
+template<typename TAG = void>
+class counting_probe
+{
+    using counter = std::atomic<uint64_t>;
+
+    struct counters
+    {
+        counter finds{ 0 };
+        counter find_misses{ 0 };
+        counter matches{ 0 };
+        counter match_misses{ 0 };
+        counter climbs{ 0 };
+        counter climb_nodes{ 0 };
+
+        std::array<counter, probe_snapshot::levels> match_depth{};
+        std::array<counter, probe_snapshot::levels> climb_length{};
+        std::array<counter, probe_snapshot::levels> probes{};
+    };
+
+    static inline counters s_counters;
+
+    static void bump(counter& c, uint64_t n = 1)
+    {
+        c.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    static size_t slot(size_t level)
+    {
+        return std::min(level, probe_snapshot::levels - 1);
+    }
+
+    template<size_t N>
+    static void copy(std::array<uint64_t, N>& dst, const std::array<counter, N>& src)
+    {
+        for (size_t i = 0; i < N; ++i) {
+            dst[i] = src[i].load(std::memory_order_relaxed);
+        }
+    }
+
+    template<size_t N>
+    static void zero(std::array<counter, N>& dst)
+    {
+        for (auto& c : dst) {
+            c.store(0, std::memory_order_relaxed);
+        }
+    }
+
+public:
+    static void find(bool hit)
+    {
+        bump(s_counters.finds);
+        if (!hit) {
+            bump(s_counters.find_misses);
+        }
+    }
+
+    static void match(bool hit, size_t depth)
+    {
+        bump(s_counters.matches);
+        if (hit) {
+            bump(s_counters.match_depth[slot(depth)]);
+        } else {
+            bump(s_counters.match_misses);
+        }
+    }
+
+    static void climb(size_t length)
+    {
+        bump(s_counters.climbs);
+        bump(s_counters.climb_nodes, length);
+        bump(s_counters.climb_length[slot(length)]);
+    }
+
+    static void probe(size_t level)
+    {
+        bump(s_counters.probes[slot(level)]);
+    }
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Read current values of the counters. Values are read one at a time, so they may be slightly inconsistent with
+    // each other while lookups are in progress.
+    //------------------------------------------------------------------------------------------------------------------
+    static probe_snapshot snapshot()
+    {
+        probe_snapshot ps;
+        ps.finds        = s_counters.finds.load(std::memory_order_relaxed);
+        ps.find_misses  = s_counters.find_misses.load(std::memory_order_relaxed);
+        ps.matches      = s_counters.matches.load(std::memory_order_relaxed);
+        ps.match_misses = s_counters.match_misses.load(std::memory_order_relaxed);
+        ps.climbs       = s_counters.climbs.load(std::memory_order_relaxed);
+        ps.climb_nodes  = s_counters.climb_nodes.load(std::memory_order_relaxed);
+        copy(ps.match_depth, s_counters.match_depth);
+        copy(ps.climb_length, s_counters.climb_length);
+        copy(ps.probes, s_counters.probes);
+        return ps;
+    }
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Reset all counters to zero
+    //------------------------------------------------------------------------------------------------------------------
+    static void reset()
+    {
+        for (auto* c : { &s_counters.finds,
+                         &s_counters.find_misses,
+                         &s_counters.matches,
+                         &s_counters.match_misses,
+                         &s_counters.climbs,
+                         &s_counters.climb_nodes }) {
+            c->store(0, std::memory_order_relaxed);
+        }
+        zero(s_counters.match_depth);
+        zero(s_counters.climb_length);
+        zero(s_counters.probes);
+    }
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+// Default node policy. Data is stored inline, next to the children container.
+//----------------------------------------------------------------------------------------------------------------------
+struct policy
+{
+    template<typename DATA>
+    using store = std::optional<DATA>;
+
+    using probe = null_probe;
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+// Node policy that keeps data out of line. A node without data costs a pointer plus the children container.
+//----------------------------------------------------------------------------------------------------------------------
+struct boxed_policy : policy
+{
+    template<typename DATA>
+    using store = details::boxed<DATA>;
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+// Node policy that caches a hash of every subtree, see triemap::digest. Unchanged subtrees of two trie-maps can then be
+// told apart in constant time. Non-const lookups return const data, which is modified through update instead.
+//----------------------------------------------------------------------------------------------------------------------
+struct hashed_policy : policy
+{
+    template<typename DATA>
+    using store = details::hashed<std::optional<DATA>>;
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+// Node policy that keeps the aggregate of every subtree, see triemap::aggregate. The monoid provides the value_type of
+// aggregates, identity() as the aggregate of a subtree without data, lift(data) and combine(a, b), which must be
+// associative and commutative. Insert, erase and update adjust the aggregates along their path, and non-const lookups
+// return const data, so there is no other way to modify it. When the monoid also provides remove(a, b), undoing
+// combine, that takes constant time per node, otherwise each node on the path combines the aggregates of its children
+// again.
+//----------------------------------------------------------------------------------------------------------------------
+template<typename MONOID>
+struct aggregate_policy : policy
+{
+    template<typename DATA>
+    using store = details::aggregated<std::optional<DATA>, MONOID>;
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+// Node policy that keeps the aggregate of every subtree but defers its maintenance. Modifications only mark the path to
+// the modified node stale, and refresh() or the next aggregate read recomputes the stale nodes bottom-up, each of them
+// once, however many modifications went through it. Bursts of updates followed by a read are cheaper than with
+// aggregate_policy, and the monoid does not need remove.
+//----------------------------------------------------------------------------------------------------------------------
+template<typename MONOID>
+struct lazy_aggregate_policy : policy
+{
+    template<typename DATA>
+    using store = details::aggregated<std::optional<DATA>, MONOID, true>;
+};
+
+// Monotonic time stamps. Unlike the wall clock, the steady clock never goes back.
+struct steady_clock
+{
+    auto operator()() const
+    {
+        return std::chrono::steady_clock::now();
+    }
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+// Node policy that keeps past versions of the data, see triemap::find_as_of. CLOCK is a default constructible functor
+// returning the time stamp of a modification, such as the steady clock or the commit time of the current transaction.
+// Stamps must be ordered and must not go back, as a modification stamped before the last version replaces it. The
+// wall clock can go back, so it is not a valid CLOCK. Insert, erase, update, merge and clear add versions, writing
+// through a pointer to the data changes the current version in place. Versions stay until trim drops those older than
+// a watermark.
+//----------------------------------------------------------------------------------------------------------------------
+template<typename CLOCK = steady_clock>
+struct versioned_policy : policy
+{
+    template<typename DATA>
+    using store = details::versioned<DATA, CLOCK>;
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+// Node policy that keeps the children of every node ordered by score, see triemap::top_k. SCORE is a default
+// constructible functor returning the score of a child node, so children can be ranked by their data or, on top of an
+// aggregate_policy given as BASE, by the aggregates of their subtrees. Scores and keys must be ordered, keys break ties.
+// Non-const lookups return const data, which is modified through update instead.
+//----------------------------------------------------------------------------------------------------------------------
+template<typename SCORE, typename BASE = policy>
+struct ranked_policy : BASE
+{
+    using score = SCORE;
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+// Node policy that sizes the children containers of new nodes for their expected fan-out, so bulk loads of unordered
+// trie-maps do not rehash the containers as they grow. FANOUT gives the expected number of children of the nodes at
+// every prefix level, starting at the root, and zero leaves a level alone. There must be one hint per level, the
+// trie-map aliases reject a list of another length. Ordered trie-maps ignore the hints.
+//----------------------------------------------------------------------------------------------------------------------
+template<typename BASE, size_t... FANOUT>
+struct basic_fanout_policy : BASE
+{
+    static constexpr std::array<size_t, sizeof...(FANOUT)> fanout{ FANOUT... };
+};
+
+template<size_t... FANOUT>
+using fanout_policy = basic_fanout_policy<policy, FANOUT...>;
+
+// Sum of the data converted to T
+template<typename T>
+struct sum_monoid
+{
+    using value_type = T;
+
+    static T identity()
+    {
+        return T();
+    }
+    template<typename D>
+    static T lift(const D& d)
+    {
+        return static_cast<T>(d);
+    }
+    static T combine(const T& a, const T& b)
+    {
+        return a + b;
+    }
+    static T remove(const T& a, const T& b)
+    {
+        return a - b;
+    }
+};
+
+// Number of data elements
+struct count_monoid
+{
+    using value_type = size_t;
+
+    static size_t identity()
+    {
+        return 0;
+    }
+    template<typename D>
+    static size_t lift(const D&)
+    {
+        return 1;
+    }
+    static size_t combine(size_t a, size_t b)
+    {
+        return a + b;
+    }
+    static size_t remove(size_t a, size_t b)
+    {
+        return a - b;
+    }
+};
+
+// Maximum of the data converted to T
+template<typename T>
+struct max_monoid
+{
+    using value_type = T;
+
+    static T identity()
+    {
+        return std::numeric_limits<T>::lowest();
+    }
+    template<typename D>
+    static T lift(const D& d)
+    {
+        return static_cast<T>(d);
+    }
+    static T combine(const T& a, const T& b)
+    {
+        return std::max(a, b);
+    }
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+// Ordered trie-map collection.
+//----------------------------------------------------------------------------------------------------------------------
+template<typename K, typename T>
+using omap = std::map<K, T, std::less<>>;
+
+template<typename POLICY, typename DATA, typename PFIX, typename... PFIXS>
+using basic_otriemap =
+    details::triemap<omap, typename details::policy_for<POLICY, 1 + sizeof...(PFIXS)>::type, DATA, PFIX, PFIXS...>;
+
+template<typename DATA, typename PFIX, typename... PFIXS>
+using otriemap = basic_otriemap<policy, DATA, PFIX, PFIXS...>;
+
+//----------------------------------------------------------------------------------------------------------------------
+// Unordered trie-map collection.
+//----------------------------------------------------------------------------------------------------------------------
+template<typename K, typename T>
+using umap = std::unordered_map<K, T>;
+
+template<typename POLICY, typename DATA, typename PFIX, typename... PFIXS>
+using basic_utriemap =
+    details::triemap<umap, typename details::policy_for<POLICY, 1 + sizeof...(PFIXS)>::type, DATA, PFIX, PFIXS...>;
+
+template<typename DATA, typename PFIX, typename... PFIXS>
+using utriemap = basic_utriemap<policy, DATA, PFIX, PFIXS...>;
+
+//----------------------------------------------------------------------------------------------------------------------
+// Path-compressed ordered trie-map collection. Runs of single-child nodes are stored inline. Inserting a sibling of a
+// lone child, or erasing or extracting all siblings but one, moves that child, so pointers to data and nodes in its
+// subtree are invalidated, unlike with the other flavours.
+//----------------------------------------------------------------------------------------------------------------------
+template<typename K, typename T>
+using ocmap = details::chain_map<omap, K, T>;
+
+template<typename POLICY, typename DATA, typename PFIX, typename... PFIXS>
+using basic_octriemap =
+    details::triemap<ocmap, typename details::policy_for<POLICY, 1 + sizeof...(PFIXS)>::type, DATA, PFIX, PFIXS...>;
+
+template<typename DATA, typename PFIX, typename... PFIXS>
+using octriemap = basic_octriemap<policy, DATA, PFIX, PFIXS...>;
+
+//----------------------------------------------------------------------------------------------------------------------
+// Path-compressed unordered trie-map collection. Runs of single-child nodes are stored inline. Inserting a sibling of a
+// lone child, or erasing or extracting all siblings but one, moves that child, so pointers to data and nodes in its
+// subtree are invalidated, unlike with the other flavours.
+//----------------------------------------------------------------------------------------------------------------------
+template<typename K, typename T>
+using ucmap = details::chain_map<umap, K, T>;
+
+template<typename POLICY, typename DATA, typename PFIX, typename... PFIXS>
+using basic_uctriemap =
+    details::triemap<ucmap, typename details::policy_for<POLICY, 1 + sizeof...(PFIXS)>::type, DATA, PFIX, PFIXS...>;
 
 template<typename DATA, typename PFIX, typename... PFIXS>
-using utriemap = details::triemap<umap, DATA, PFIX, PFIXS...>;
+using uctriemap = basic_uctriemap<policy, DATA, PFIX, PFIXS...>;
 
 } // namespace O3::collection
 